@@ -4,14 +4,17 @@
    driver for the lzw compression algorithm Part 1
 */
 
-#include "lzwAlgorithm435.hpp"
-#include <sstream> // std::stringstream
+#include "lzwCodec435.hpp"
+#include "lzwFileIO435.hpp"
+#include <iostream>
 
 void compressionDriver(const std::string &filename);
 void decompressionDriver(const std::string &filename);
 void compressionWriteResult(const std::string &filename, const std::vector<int> &compressed);
 std::string compressionReadResult(const std::string &filename);
 bool isValidFileExtension(const std::string &filename, const std::string &extension);
+std::string int2BinaryString(int c, int cl);
+int binaryString2Int(std::string p);
 
 int main(int argc, char* argv[]) 
 {
@@ -63,11 +66,9 @@ void compressionDriver(const std::string &filename)
       return;
    }
  
-   //open the input file
-   std::ifstream inFile;
-   inFile.open(filename); 
-
-   if (!inFile)
+   //map the input file, the encoder reads it in place
+   MappedFile inFile;
+   if (!inFile.open(filename))
    {
       std::cerr << "Error: unable to open file '" << filename << "'\n";
       std::cerr << "Please ensure it is located in the same directory as the executable" << std::endl;
@@ -75,16 +76,14 @@ void compressionDriver(const std::string &filename)
       return;
    }
 
-   // read the contents of the file and store in string
-   std::stringstream sstream;
-   sstream << inFile.rdbuf();
-   std::string inputTxt = sstream.str(); 
+   // Part 1 uses fixed 12 bit codes, so the dictionary holds 4096 = 2^12 entries
+   int bits = 12;
 
    // pass string to compress and a back_insert_iterator that inserts elements at the end of container "compressed".
    // std::vector<int> compressed holds the sequence of codes produced by LZW compression 
    std::vector<int> compressed;
 
-   compress(inputTxt, std::back_inserter(compressed));
+   compress(inFile.data(), inFile.size(), std::back_inserter(compressed), bits);
 
    // Binary IO to write compression results
    compressionWriteResult(filename, compressed);
@@ -119,14 +118,14 @@ void decompressionDriver(const std::string &filename)
       codeSequence.push_back(code);
    }
 
-   // remove the final code if its a 0
-   if (codeSequence.back() == 0) 
+   // remove the final code if its a 0 (an empty file has no codes at all)
+   if (!codeSequence.empty() && codeSequence.back() == 0) 
    {
       codeSequence.pop_back();
    }
 
    // decompress and write result
-   std::string decompressed = decompress(codeSequence.begin(), codeSequence.end());
+   std::vector<unsigned char> decompressed = decompress(codeSequence.begin(), codeSequence.end(), bits);
 
    // produce substring of filename with extension removed
    // assuming the file extension is ".lzw", we know we don't want the final 4 characters
@@ -135,9 +134,12 @@ void decompressionDriver(const std::string &filename)
    // derive file name target
    std::string derivedFileToWrite = extensionlessFileName + "2.txt"; 
 
-   std::ofstream outFile;
-   outFile.open(derivedFileToWrite.c_str());
-   outFile << decompressed;
+   if (!writeWholeFile(derivedFileToWrite, decompressed.data(), decompressed.size()))
+   {
+      std::cerr << "Error: unable to write file '" << derivedFileToWrite << "'" << std::endl;
+
+      return;
+   }
    std::cout << "Results of decompression written -> " << derivedFileToWrite << "'\n";
 
    return;
@@ -174,9 +176,10 @@ void compressionWriteResult(const std::string &filename, const std::vector<int>
    // derive file name target
    std::string derivedFileToWrite = extensionlessFileName + ".lzw"; 
 
-   std::ofstream outFile;
-   outFile.open(derivedFileToWrite.c_str(),  std::ios::binary);
-   
+   // collect the bytes and write them in one go
+   std::vector<unsigned char> output;
+   output.reserve(bCode.size() / 8);
+
    int byteValue; 
    for (int i = 0; i < bCode.size(); i += 8)
    { 
@@ -189,8 +192,14 @@ void compressionWriteResult(const std::string &filename, const std::vector<int>
             byteValue += 1;
          }
       }
-      char outputByte = (char) (byteValue & 255); // save the string byte by byte
-      outFile.write(&outputByte, 1);  
+      output.push_back((unsigned char) (byteValue & 255)); // save the string byte by byte
+   }
+
+   if (!writeWholeFile(derivedFileToWrite, output.data(), output.size()))
+   {
+      std::cerr << "Error: unable to write file '" << derivedFileToWrite << "'" << std::endl;
+
+      return;
    }
 
    std::cout << "Results of compression written -> " << derivedFileToWrite << "'\n";
@@ -200,10 +209,8 @@ void compressionWriteResult(const std::string &filename, const std::vector<int>
 
 std::string compressionReadResult(const std::string &filename) 
 {
-   std::ifstream inFile;
-   inFile.open(filename.c_str(),  std::ios::binary); 
-
-   if (!inFile)
+   MappedFile inFile;
+   if (!inFile.open(filename))
    {
       std::cerr << "Error: unable to open file '" << filename << "'\n";
       std::cerr << "Please ensure it is located in the same directory as the executable" << std::endl;
@@ -211,12 +218,8 @@ std::string compressionReadResult(const std::string &filename)
       exit(1);
    }
 
-   struct stat filestatus;
-   stat(filename.c_str(), &filestatus );
-   long fsize = filestatus.st_size; // get the size of the file in bytes
-
-   char contents[fsize];
-   inFile.read(contents, fsize);
+   long fsize = inFile.size(); // get the size of the file in bytes
+   const unsigned char *contents = inFile.data();
    std::string zeros = "00000000";
    
    // empty string to hold the binary representation of the file contents
@@ -228,7 +231,7 @@ std::string compressionReadResult(const std::string &filename)
    while(byteCount < fsize) 
    {
       // Convert the byte to an unsigned char
-      unsigned char unsignedByte =  (unsigned char) contents[byteCount];
+      unsigned char unsignedByte = contents[byteCount];
 
       // Convert the byte to a binary string
       std::string byteBinaryString = ""; //a binary string
@@ -274,3 +277,43 @@ bool isValidFileExtension(const std::string &filename, const std::string &extens
 
    return true;
 }
+
+//
+std::string int2BinaryString(int c, int cl) {
+      std::string p = ""; //a binary code string with code length = cl
+      int code = c;
+      while (c>0) {
+		   if (c%2==0)
+            p="0"+p;
+         else
+            p="1"+p;
+         c=c>>1;
+      }
+      int zeros = cl-p.size();
+      if (zeros<0) {
+         std::cout << "\nWarning: Overflow. code " << code <<" is too big to be coded by " << cl <<" bits!\n";
+         p = p.substr(p.size()-cl);
+      }
+      else {
+         for (int i=0; i<zeros; i++)  //pad 0s to left of the binary code if needed
+            p = "0" + p;
+      }
+      return p;
+}
+
+//
+int binaryString2Int(std::string p) {
+   int code = 0;
+   if (p.size()>0) {
+      if (p.at(0)=='1')
+         code = 1;
+      p = p.substr(1);
+      while (p.size()>0) {
+         code = code << 1;
+		   if (p.at(0)=='1')
+            code++;
+         p = p.substr(1);
+      }
+   }
+   return code;
+}
@@ -4,19 +4,26 @@
    driver for the lzw compression algorithm Part 2
 */
 
-#include "lzwAlgorithm435M.hpp"
-#include <sstream> // std::stringstream
-#include <unordered_set>
-
-void compressionDriver(const std::string &filename);
-void decompressionDriver(const std::string &filename);
-void compressionWriteResult(const std::string &filename, const std::vector<int> &compressed);
-std::string compressionReadResult(const std::string &filename);
+#include "lzwLibrary435M.hpp"
+#include "lzwArchive435M.hpp"
+#include <cstdlib> // std::strtoull
+#include <iostream>
+#include <iomanip>
+
+bool compressionDriver(const std::string &filename, const std::string &outputName, const Lzw2Options &options, const Lzw2Dictionary *dictionary);
+bool decompressionDriver(const std::string &filename, const std::string &outputName, const Lzw2Dictionary *dictionary);
+bool rangeDriver(const std::string &filename, std::uint64_t offset, std::uint64_t length, const std::string &outputName, const Lzw2Dictionary *dictionary);
+bool trainingDriver(const std::string &dictionaryName, const std::vector<std::string> &sampleNames, std::size_t capacity);
+bool archiveDriver(const std::string &directory, const std::string &outputName, const Lzw2Options &options, const Lzw2Dictionary *dictionary, unsigned threads);
+bool extractionDriver(const std::string &filename, const std::vector<std::string> &memberNames, const std::string &outputName,
+                      const Lzw2Dictionary *dictionary, unsigned threads);
+bool listingDriver(const std::string &filename);
+bool loadDictionary(const std::string &filename, Lzw2Dictionary &dictionary);
+bool openInputFile(const std::string &filename, MappedFile &input);
+bool writeOutputFile(const std::string &filename, const std::vector<unsigned char> &contents);
 bool isValidFileExtension(const std::string &filename, const std::string &extension);
 
-const std::unordered_set<int> POWERS_OF_2 = { 512, 1024, 2048, 4096, 8192, 16384, 32768 };
-
-int main(int argc, char* argv[]) 
+int main(int argc, char* argv[])
 {
    std::cout << " ________________________________________________________________ " << std::endl;
    std::cout << "|                                                                |" << std::endl;
@@ -24,277 +31,452 @@ int main(int argc, char* argv[])
    std::cout << "|________________________________________________________________|" << std::endl << std::endl;
 
    // validate # of command-line args
-   if (argc != 3)
+   if (argc < 3)
    {
       std::cerr << "Error: invalid invocation" << std::endl;
-      std::cerr << "Required Format: ./lzw435 <c/e> <filename>" << std::endl;
-      
+      std::cerr << "Required Format: ./lzw435M <c/e> <filename> [flags]" << std::endl;
+      std::cerr << "                 ./lzw435M s <filename> [block size] [flags]" << std::endl;
+      std::cerr << "                 ./lzw435M r <filename> <offset> <length> [flags]" << std::endl;
+      std::cerr << "                 ./lzw435M t <dictionary> <sample> [sample ...] [--dict-size=<bytes>]" << std::endl;
+      std::cerr << "                 ./lzw435M a <directory> [flags]" << std::endl;
+      std::cerr << "                 ./lzw435M x <archive> [file ...] [flags]" << std::endl;
+      std::cerr << "                 ./lzw435M l <archive>" << std::endl;
+      std::cerr << "Flags: --output=<path> --no-clear --range --max-bits=<9-24> --growth=<lzw|lzmw|lzap> --dict=<dictionary> --hash" << std::endl;
+      std::cerr << "       --threads=<n> (a and x)" << std::endl;
+
       return 1;
    }
 
    char option = *(argv[1]);
    std::string filename(argv[2]);
-   switch (option)
+
+   // trailing flags
+   Lzw2Options options;
+   std::string outputName;     // derived from filename when not given
+   std::string dictionaryName; // preset dictionary to compress or expand with
+   std::size_t dictionaryCapacity = DICTIONARY_DEFAULT_SIZE;
+   unsigned threads = defaultThreadCount();
+   while (argc > 3 && std::string(argv[argc - 1]).compare(0, 2, "--") == 0)
    {
-      case 'c':
-      case 'C':
-         std::cout << "Option Select: compress '" << filename << "'\n\n";
-         compressionDriver(filename);
-         break;
-      case 'e':
-      case 'E': 
-         std::cout << "Option Select: expand '" << filename << "'\n\n";
-
-         try 
+      std::string flag(argv[--argc]);
+      if (flag.compare(0, 9, "--output=") == 0)
+      {
+         outputName = flag.substr(9);
+      }
+      else if (flag == "--no-clear")
+      {
+         // never emit CLEAR codes; the dictionary stays frozen once full
+         options.clearCodes = false;
+      }
+      else if (flag.compare(0, 7, "--dict=") == 0)
+      {
+         dictionaryName = flag.substr(7);
+      }
+      else if (flag.compare(0, 12, "--dict-size=") == 0)
+      {
+         // bytes of primer to train
+         dictionaryCapacity = std::strtoull(flag.c_str() + 12, NULL, 10);
+         if (dictionaryCapacity == 0)
          {
-            decompressionDriver(filename);
-         } catch(const char *a) {
-             std::cout << a;
+            std::cerr << "Error: dictionary size must be a positive number of bytes" << std::endl;
+            return 1;
          }
-         break;
-      default:
-         std::cerr << "Error: unrecognized option '" << option
-                   << "'. Valid options are 'c' for compress, and 'e' for expand (decompression)" << std::endl;
+      }
+      else if (flag == "--range")
+      {
+         // entropy code the LZW codes instead of writing them at full width
+         options.rangeCoded = true;
+      }
+      else if (flag.compare(0, 10, "--threads=") == 0)
+      {
+         // files compressed or extracted at once in archive mode
+         threads = std::atoi(flag.c_str() + 10);
+         if (threads == 0)
+         {
+            std::cerr << "Error: thread count must be a positive number" << std::endl;
+            return 1;
+         }
+      }
+      else if (flag == "--hash")
+      {
+         // look phrases up in the packed hash table instead of the trie (plain LZW only, same output)
+         options.hashedEncoder = true;
+      }
+      else if (flag.compare(0, 11, "--max-bits=") == 0)
+      {
+         // dictionary holds up to 2^max-bits entries
+         options.maxCodeWidth = std::atoi(flag.c_str() + 11);
+         if (!isValidCodeWidth(options.maxCodeWidth))
+         {
+            std::cerr << "Error: max code width must be between " << LZW_MIN_CODE_WIDTH << " and " << LZW_MAX_CODE_WIDTH << " bits" << std::endl;
+            return 1;
+         }
+      }
+      else if (flag.compare(0, 9, "--growth=") == 0)
+      {
+         // which phrases are added to the dictionary after each match
+         std::string growth = flag.substr(9);
+         if (growth == "lzw")
+         {
+            options.growth = GROWTH_LZW;
+         }
+         else if (growth == "lzmw")
+         {
+            options.growth = GROWTH_LZMW;
+         }
+         else if (growth == "lzap")
+         {
+            options.growth = GROWTH_LZAP;
+         }
+         else
+         {
+            std::cerr << "Error: growth policy must be one of lzw, lzmw or lzap" << std::endl;
+            return 1;
+         }
+      }
+      else
+      {
+         std::cerr << "Error: unrecognized flag '" << flag << "'" << std::endl;
          return 1;
+      }
+   }
+
+   try
+   {
+      Lzw2Dictionary loaded;
+      const Lzw2Dictionary *dictionary = NULL;
+      if (!dictionaryName.empty())
+      {
+         if (!loadDictionary(dictionaryName, loaded))
+         {
+            return 1;
+         }
+         dictionary = &loaded;
+      }
+
+      bool succeeded = true;
+      switch (option)
+      {
+         case 'c':
+         case 'C':
+            std::cout << "Option Select: compress '" << filename << "'\n\n";
+            succeeded = compressionDriver(filename, outputName, options, dictionary);
+            break;
+         case 's':
+         case 'S':
+         {
+            // seekable compression: cut the input into blocks and append a block index
+            options.indexed = true;
+            options.blockSize = argc >= 4 ? std::strtoull(argv[3], NULL, 10) : LZW2_DEFAULT_BLOCK_SIZE;
+            if (options.blockSize == 0)
+            {
+               std::cerr << "Error: block size must be a positive number of bytes" << std::endl;
+               return 1;
+            }
+            std::cout << "Option Select: compress (seekable, " << options.blockSize << " byte blocks) '" << filename << "'\n\n";
+            succeeded = compressionDriver(filename, outputName, options, dictionary);
+            break;
+         }
+         case 'e':
+         case 'E':
+            std::cout << "Option Select: expand '" << filename << "'\n\n";
+            succeeded = decompressionDriver(filename, outputName, dictionary);
+            break;
+         case 'r':
+         case 'R':
+            if (argc != 5)
+            {
+               std::cerr << "Error: invalid invocation" << std::endl;
+               std::cerr << "Required Format: ./lzw435M r <filename> <offset> <length>" << std::endl;
+               return 1;
+            }
+            std::cout << "Option Select: expand range [" << argv[3] << ", +" << argv[4] << ") of '" << filename << "'\n\n";
+            succeeded = rangeDriver(filename, std::strtoull(argv[3], NULL, 10), std::strtoull(argv[4], NULL, 10), outputName, dictionary);
+            break;
+         case 't':
+         case 'T':
+            // train a preset dictionary (written to filename) from the sample files that follow it
+            if (argc < 4)
+            {
+               std::cerr << "Error: invalid invocation" << std::endl;
+               std::cerr << "Required Format: ./lzw435M t <dictionary> <sample> [sample ...]" << std::endl;
+               return 1;
+            }
+            std::cout << "Option Select: train dictionary '" << filename << "' from " << argc - 3 << " sample(s)\n\n";
+            succeeded = trainingDriver(filename, std::vector<std::string>(argv + 3, argv + argc), dictionaryCapacity);
+            break;
+         case 'a':
+         case 'A':
+            // archive every file below the directory filename
+            std::cout << "Option Select: archive directory '" << filename << "' (" << threads << " threads)\n\n";
+            succeeded = archiveDriver(filename, outputName, options, dictionary, threads);
+            break;
+         case 'x':
+         case 'X':
+            // extract the files named after the archive, or all of them
+            std::cout << "Option Select: extract archive '" << filename << "'\n\n";
+            succeeded = extractionDriver(filename, std::vector<std::string>(argv + 3, argv + argc), outputName, dictionary, threads);
+            break;
+         case 'l':
+         case 'L':
+            std::cout << "Option Select: list archive '" << filename << "'\n\n";
+            succeeded = listingDriver(filename);
+            break;
+         default:
+            std::cerr << "Error: unrecognized option '" << option
+                      << "'. Valid options are 'c' for compress, 's' for seekable compress, 'e' for expand (decompression)"
+                      << ", 'r' for expanding a byte range, 't' for training a dictionary, 'a' for archiving a directory"
+                      << ", 'x' for extracting an archive and 'l' for listing one" << std::endl;
+            return 1;
+      }
+      if (!succeeded)
+      {
+         return 1;
+      }
+   } catch(const char *a) {
+       std::cerr << "Error: " << a << std::endl;
+       return 1;
+   } catch(const std::exception &e) {
+       std::cerr << "Error: " << e.what() << std::endl;
+       return 1;
    }
 
    return 0;
 }
 
-void compressionDriver(const std::string &filename)
+bool compressionDriver(const std::string &filename, const std::string &outputName, const Lzw2Options &options, const Lzw2Dictionary *dictionary)
 {
-   // validate file is a .txt
-   if (!isValidFileExtension(filename, ".txt"))
+   // map the raw bytes of the file; any file can be compressed, text or binary
+   MappedFile input;
+   if (!openInputFile(filename, input))
    {
-      std::cerr << "Error: unsupported file extension" << std::endl;
-      std::cerr << "Compression can only be performed on a text file" << std::endl;
-
-      return;
+      return false;
    }
- 
-   //open the input file
-   std::ifstream inFile;
-   inFile.open(filename); 
 
-   if (!inFile)
+   // derive file name target unless one was given: example.txt -> example.lzw2, anything else gets .lzw2 appended
+   std::string derivedFileToWrite = outputName;
+   if (derivedFileToWrite.empty())
    {
-      std::cerr << "Error: unable to open file '" << filename << "'\n";
-      std::cerr << "Please ensure it is located in the same directory as the executable" << std::endl;
-
-      return;
+      std::string extensionlessFileName = isValidFileExtension(filename, ".txt") ? filename.substr(0, filename.length() - 4) : filename;
+      derivedFileToWrite = extensionlessFileName + ".lzw2";
    }
 
-   // read the contents of the file and store in string
-   std::stringstream sstream;
-   sstream << inFile.rdbuf();
-   std::string inputTxt = sstream.str(); 
-
-   // pass string to compress and a back_insert_iterator that inserts elements at the end of container "compressed".
-   // std::vector<int> compressed holds the sequence of codes produced by LZW compression 
-   std::vector<int> compressed;
-
-   compress(inputTxt, std::back_inserter(compressed));
+   // compress straight from the mapping and write the .lzw2 container
+   Lzw2Encoder encoder(options, dictionary);
+   std::vector<unsigned char> compressed;
+   encoder.compress(input.data(), input.size(), compressed);
 
-   // Binary IO to write compression results
-   compressionWriteResult(filename, compressed);
+   if (!writeOutputFile(derivedFileToWrite, compressed))
+   {
+      return false;
+   }
+   std::cout << "Results of compression written -> " << derivedFileToWrite << "'\n";
 
-   return;
+   return true;
 }
 
-void decompressionDriver(const std::string &filename) 
+bool decompressionDriver(const std::string &filename, const std::string &outputName, const Lzw2Dictionary *dictionary)
 {
-   // validate file is a .lzw
-   if (!isValidFileExtension(filename, ".lzw2"))
+   MappedFile input;
+   if (!openInputFile(filename, input))
    {
-      std::cerr << "Error: unsupported file extension" << std::endl;
-      std::cerr << "Expansion can only be performed on a .lzw2 file" << std::endl;
-
-      return;
+      return false;
    }
 
-   // binary IO to read result of compression 
-   std::string binaryString = compressionReadResult(filename);
-
-   // convert to integer code sequence
-         
-   int bits = 9; // code word length begins at 9
-   int codeCount = 256; // counter to keep track of how many bits to use for code words
-   std::vector<int> codeSequence;
-   
-   // convert n bits at a time and push into vector 
-   std::string chunk;
-   int code;
-   for (int i = 0; i < binaryString.size(); i += bits) 
-   {
-      if (POWERS_OF_2.count(codeCount))
-      {
-         --i;
-      }
+   // decompress every block of the container (the header identifies it as .lzw2, whatever its name)
+   Lzw2Decoder decoder(dictionary);
+   std::vector<unsigned char> decompressed;
+   decoder.decompress(input.data(), input.size(), decompressed);
 
-      chunk = binaryString.substr(i, bits);
+   // derive file name target unless one was given: example.lzw2 -> example2M
+   std::string derivedFileToWrite = outputName;
+   if (derivedFileToWrite.empty())
+   {
+      std::string extensionlessFileName = isValidFileExtension(filename, ".lzw2") ? filename.substr(0, filename.length() - 5) : filename;
+      derivedFileToWrite = extensionlessFileName + "2M";
+   }
 
-      // we've reached the next power of 2, time to increment bits
-      if (POWERS_OF_2.count(codeCount))
-      {
-         ++bits;
-      }
+   if (!writeOutputFile(derivedFileToWrite, decompressed))
+   {
+      return false;
+   }
+   std::cout << "Results of decompression written -> " << derivedFileToWrite << "'\n";
 
-      code = binaryString2Int(chunk);
+   return true;
+}
 
-      codeSequence.push_back(code);
+bool rangeDriver(const std::string &filename, std::uint64_t offset, std::uint64_t length, const std::string &outputName, const Lzw2Dictionary *dictionary)
+{
+   // only the blocks overlapping the range are decoded when the file carries a block index
+   std::vector<unsigned char> slice = decompressRange(filename, offset, length, dictionary);
 
-      // increment codeCount
-      ++codeCount;
+   // derive file name target unless one was given (./lzw435M r example.lzw2 100 20  --->  example_100_20)
+   std::string derivedFileToWrite = outputName;
+   if (derivedFileToWrite.empty())
+   {
+      std::string extensionlessFileName = isValidFileExtension(filename, ".lzw2") ? filename.substr(0, filename.length() - 5) : filename;
+      derivedFileToWrite = extensionlessFileName + "_" + std::to_string(offset) + "_" + std::to_string(length);
    }
 
-   // remove the final code if its a 0
-   if (codeSequence.back() == 0) 
+   if (!writeOutputFile(derivedFileToWrite, slice))
    {
-      codeSequence.pop_back();
+      return false;
    }
-   
-   // decompress and write result
-   std::string decompressed = decompress(codeSequence.begin(), codeSequence.end());
-
-   // produce substring of filename with extension removed
-   // assuming the file extension is ".lzw", we know we don't want the final 4 characters
-   std::string extensionlessFileName = filename.substr(0, filename.length() - 4);
-   
-   // derive file name target
-   std::string derivedFileToWrite = extensionlessFileName + "2M"; 
-
-   std::ofstream outFile;
-   outFile.open(derivedFileToWrite.c_str());
-   outFile << decompressed;
-   std::cout << "Results of decompression written -> " << derivedFileToWrite << "'\n";
+   std::cout << "Results of range expansion (" << slice.size() << " bytes) written -> " << derivedFileToWrite << "'\n";
 
-   return;
+   return true;
 }
 
-void compressionWriteResult(const std::string &filename, const std::vector<int> &compressed) 
+bool trainingDriver(const std::string &dictionaryName, const std::vector<std::string> &sampleNames, std::size_t capacity)
 {
-   // code word length begins at 9 
-   int bits = 9;
+   std::vector<std::vector<unsigned char> > samples;
+   for (std::size_t i = 0; i < sampleNames.size(); ++i)
+   {
+      MappedFile sample;
+      if (!openInputFile(sampleNames[i], sample))
+      {
+         return false;
+      }
+      samples.push_back(std::vector<unsigned char>(sample.data(), sample.data() + sample.size()));
+   }
 
-   // counter to keep track of how many bits to use for code words
-   int codeCount = 256;
+   Lzw2Dictionary dictionary = trainDictionary(samples, capacity);
 
-   std::string bCode = "";
-   std::string bCodeTemp = "";
-   for (std::vector<int>::const_iterator itr = compressed.begin() ; itr != compressed.end(); ++itr) 
+   std::vector<unsigned char> serialized;
+   writeDictionary(serialized, dictionary);
+   if (!writeOutputFile(dictionaryName, serialized))
    {
-      // convert current code to bits and append to running string of full byte code string
-      bCodeTemp = int2BinaryString(*itr, bits);
-      bCode += bCodeTemp;
+      return false;
+   }
+   std::cout << "Dictionary of " << dictionary.getPrimer().size() << " bytes written -> " << dictionaryName << "'\n";
+
+   return true;
+}
 
-      // we've reached the next power of 2, time to increment bits
-      if (POWERS_OF_2.count(codeCount))
+bool archiveDriver(const std::string &directory, const std::string &outputName, const Lzw2Options &options, const Lzw2Dictionary *dictionary, unsigned threads)
+{
+   // derive file name target unless one was given: example/ -> example.lzwa
+   std::string derivedFileToWrite = outputName;
+   if (derivedFileToWrite.empty())
+   {
+      std::string directoryName = directory;
+      while (directoryName.size() > 1 && directoryName[directoryName.size() - 1] == '/')
       {
-         ++bits;
+         directoryName.erase(directoryName.size() - 1);
       }
-      
-      // increment codeCount
-      ++codeCount;
+      derivedFileToWrite = directoryName + ".lzwa";
    }
 
-   std::string zeros = "00000000";
-   // make sure the length of the binary string is a multiple of 8
-   if (bCode.size() % 8 != 0) 
+   std::vector<ArchiveMember> members = writeArchive(derivedFileToWrite, directory, options, dictionary, threads);
+
+   std::uint64_t totalSize = 0;
+   for (std::size_t i = 0; i < members.size(); ++i)
+   {
+      totalSize += members[i].uncompressedSize;
+   }
+   std::cout << "Archive of " << members.size() << " files (" << totalSize << " bytes) written -> " << derivedFileToWrite << "'\n";
+
+   return true;
+}
+
+bool extractionDriver(const std::string &filename, const std::vector<std::string> &memberNames, const std::string &outputName,
+                      const Lzw2Dictionary *dictionary, unsigned threads)
+{
+   MappedFile input;
+   if (!openInputFile(filename, input))
    {
-      // if not, pad with 0s
-      bCode += zeros.substr(0, 8 - bCode.size() % 8);
+      return false;
    }
+   std::vector<ArchiveMember> members = readArchiveToc(input.data(), input.size());
 
-   /* WRITING TO FILE */
-
-   // produce substring of filename with extension removed
-   // assuming the file extension is ".txt", we know we don't want the final 4 characters
-   std::string extensionlessFileName = filename.substr(0, filename.length() - 4);
-   
-   // derive file name target
-   std::string derivedFileToWrite = extensionlessFileName + ".lzw2"; 
-
-   std::ofstream outFile;
-   outFile.open(derivedFileToWrite.c_str(),  std::ios::binary);
-   
-   int byteValue; 
-   for (int i = 0; i < bCode.size(); i += 8)
-   { 
-      byteValue= 1;
-      for (int j = 0; j < 8; j++) 
+   // only the named files, if any were named
+   if (!memberNames.empty())
+   {
+      std::vector<ArchiveMember> selected;
+      for (std::size_t i = 0; i < memberNames.size(); ++i)
       {
-         byteValue = byteValue << 1;
-         if (bCode.at(i+j) == '1')
+         std::vector<ArchiveMember>::const_iterator member = members.begin();
+         while (member != members.end() && member->path != memberNames[i])
+         {
+            ++member;
+         }
+         if (member == members.end())
          {
-            byteValue += 1;
+            std::cerr << "Error: '" << memberNames[i] << "' is not in the archive" << std::endl;
+            return false;
          }
+         selected.push_back(*member);
       }
-      char outputByte = (char) (byteValue & 255); // save the string byte by byte
-      outFile.write(&outputByte, 1);  
+      members.swap(selected);
    }
 
-   std::cout << "Results of compression written -> " << derivedFileToWrite << "'\n";
+   // derive directory target unless one was given: example.lzwa -> example2M/
+   std::string derivedDirectory = outputName;
+   if (derivedDirectory.empty())
+   {
+      std::string extensionlessFileName = isValidFileExtension(filename, ".lzwa") ? filename.substr(0, filename.length() - 5) : filename;
+      derivedDirectory = extensionlessFileName + "2M";
+   }
+
+   extractArchive(input.data(), members, derivedDirectory, dictionary, threads);
+   std::cout << members.size() << " files extracted -> " << derivedDirectory << "/'\n";
 
-   return;
+   return true;
 }
 
-std::string compressionReadResult(const std::string &filename) 
+bool listingDriver(const std::string &filename)
 {
-   std::ifstream inFile;
-   inFile.open(filename.c_str(),  std::ios::binary); 
+   MappedFile input;
+   if (!openInputFile(filename, input))
+   {
+      return false;
+   }
 
-   if (!inFile)
+   std::vector<ArchiveMember> members = readArchiveToc(input.data(), input.size());
+   for (std::size_t i = 0; i < members.size(); ++i)
    {
-      std::cerr << "Error: unable to open file '" << filename << "'\n";
-      std::cerr << "Please ensure it is located in the same directory as the executable" << std::endl;
+      std::cout << std::setw(12) << members[i].uncompressedSize << std::setw(12) << members[i].compressedSize << "  " << members[i].path << "\n";
+   }
+
+   return true;
+}
 
-      exit(1);
+bool loadDictionary(const std::string &filename, Lzw2Dictionary &dictionary)
+{
+   MappedFile input;
+   if (!openInputFile(filename, input))
+   {
+      return false;
    }
 
-   struct stat filestatus;
-   stat(filename.c_str(), &filestatus );
-   long fsize = filestatus.st_size; // get the size of the file in bytes
-
-   char contents[fsize];
-   inFile.read(contents, fsize);
-   std::string zeros = "00000000";
-   
-   // empty string to hold the binary representation of the file contents
-   std::string binaryString = "";
-   
-   // loop controls 
-   long byteCount = 0;
-   
-   while(byteCount < fsize) 
+   dictionary = readDictionary(input.data(), input.size());
+   return true;
+}
+
+bool openInputFile(const std::string &filename, MappedFile &input)
+{
+   // map the input file; the codec reads it in place
+   if (!input.open(filename))
    {
-      // Convert the byte to an unsigned char
-      unsigned char unsignedByte =  (unsigned char) contents[byteCount];
-
-      // Convert the byte to a binary string
-      std::string byteBinaryString = ""; //a binary string
-      for (int j = 0; j < 8 && unsignedByte > 0; j++) 
-      {         
-		   if (unsignedByte % 2 == 0)
-         {
-            byteBinaryString= "0" + byteBinaryString;
-         }
-         else
-         {
-            byteBinaryString = "1" + byteBinaryString;
-         }
-         unsignedByte = unsignedByte >> 1;   
-      }
+      std::cerr << "Error: unable to open file '" << filename << "'\n";
+      std::cerr << "Please ensure it is located in the same directory as the executable" << std::endl;
+
+      return false;
+   }
 
-      // Pad the binary string with zeros if necessary
-      byteBinaryString = zeros.substr(0, 8-byteBinaryString.size()) + byteBinaryString; 
+   return true;
+}
 
-      // Append the binary string to the overall binary representation of the file
-      binaryString += byteBinaryString; 
+bool writeOutputFile(const std::string &filename, const std::vector<unsigned char> &contents)
+{
+   if (!writeWholeFile(filename, contents.data(), contents.size()))
+   {
+      std::cerr << "Error: unable to write file '" << filename << "'" << std::endl;
 
-      byteCount++;
-   } 
+      return false;
+   }
 
-   return binaryString;
+   return true;
 }
 
 bool isValidFileExtension(const std::string &filename, const std::string &extension)
@@ -314,4 +496,3 @@ bool isValidFileExtension(const std::string &filename, const std::string &extens
 
    return true;
 }
-
@@ -0,0 +1,418 @@
+/*
+    lzwArchive435M.hpp
+
+    .lzwa archives for lzw compression Part 2: a whole directory tree in one file, compressed file by file on a
+    pool of worker threads, with any file extractable on its own
+
+    .lzwa layout (all multi-byte integers are little-endian)
+
+        header  : "LZWA" | version (1 byte)
+        members : one complete .lzw2 stream (lzwContainer435M.hpp) per file, in table of contents order
+        toc     : one entry per file
+                  { path length (2 bytes) | path | stream offset (8 bytes) | stream size (8 bytes) | file size (8 bytes) }
+        trailer : toc offset (8 bytes) | file count (4 bytes) | CRC32C of the toc (4 bytes)
+
+    paths are relative to the archived directory, '/' separated. every member carries its own header and block
+    checksums, so extracting one file only reads the trailer, the table of contents and that file's stream.
+
+    compression hands files to the workers in table of contents order, and the calling thread writes each
+    stream to the archive as soon as it and all streams before it are done. workers stay at most
+    ARCHIVE_WINDOW_PER_THREAD files per thread ahead of the writer, which bounds the memory held in finished
+    streams however large the tree is.
+
+    yes, I know I'm not supposed to put code in a header file
+*/
+
+#ifndef LZWARCHIVE435M_HPP
+#define LZWARCHIVE435M_HPP
+
+#include "lzwLibrary435M.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+const char LZWA_MAGIC[4] = { 'L', 'Z', 'W', 'A' };
+const unsigned char LZWA_VERSION = 1;
+const int LZWA_HEADER_SIZE = 5;
+const int LZWA_TRAILER_SIZE = 16;
+const int LZWA_ENTRY_FIXED_SIZE = 26; // everything in a toc entry but the path
+const std::size_t LZWA_MAX_PATH = 65535;
+
+const std::size_t ARCHIVE_WINDOW_PER_THREAD = 4; // finished streams each worker may hold before the writer catches up
+
+struct ArchiveMember
+{
+   std::string path;
+   std::uint64_t offset;           // where the member's .lzw2 stream starts in the archive
+   std::uint64_t compressedSize;   // length of that stream
+   std::uint64_t uncompressedSize; // size of the file
+};
+
+// number of workers to use when none is requested
+inline unsigned defaultThreadCount()
+{
+   unsigned threads = std::thread::hardware_concurrency();
+   return threads > 0 ? threads : 1;
+}
+
+/* WRITING */
+
+// a file in flight between the workers and the writer
+struct ArchiveJob
+{
+   std::vector<unsigned char> stream;
+   std::uint64_t uncompressedSize;
+   const char *error; // set instead of stream when the file could not be compressed
+   bool done;
+
+   ArchiveJob() : uncompressedSize(0), error(NULL), done(false) {}
+};
+
+inline void writeArchiveToc(std::vector<unsigned char> &out, const std::vector<ArchiveMember> &members)
+{
+   for (std::vector<ArchiveMember>::const_iterator itr = members.begin(); itr != members.end(); ++itr)
+   {
+      writeLittleEndian(out, itr->path.size(), 2);
+      out.insert(out.end(), itr->path.begin(), itr->path.end());
+      writeLittleEndian(out, itr->offset, 8);
+      writeLittleEndian(out, itr->compressedSize, 8);
+      writeLittleEndian(out, itr->uncompressedSize, 8);
+   }
+}
+
+// Compress every regular file below directory into the archive archiveName, threadCount files at a time.
+// Returns the table of contents written.
+inline std::vector<ArchiveMember> writeArchive(const std::string &archiveName, const std::string &directory, const Lzw2Options &options,
+                                               const Lzw2Dictionary *dictionary, unsigned threadCount)
+{
+   std::vector<std::string> paths;
+   if (!listFiles(directory, paths))
+   {
+      throw "Unable to read directory to archive";
+   }
+   for (std::size_t i = 0; i < paths.size(); ++i)
+   {
+      if (paths[i].size() > LZWA_MAX_PATH)
+      {
+         throw "Path too long for lzw archive";
+      }
+   }
+
+   OutputFile archive;
+   if (!archive.open(archiveName))
+   {
+      throw "Unable to create lzw archive";
+   }
+   std::vector<unsigned char> header;
+   for (int i = 0; i < 4; ++i)
+   {
+      header.push_back((unsigned char) LZWA_MAGIC[i]);
+   }
+   header.push_back(LZWA_VERSION);
+   if (!archive.write(header.data(), header.size()))
+   {
+      throw "Unable to write lzw archive";
+   }
+
+   // one encoder per worker, built here so the dictionary is primed before any thread reads it
+   threadCount = std::max(1u, std::min<unsigned>(threadCount, std::max<std::size_t>(paths.size(), 1)));
+   std::vector<Lzw2Encoder> encoders(threadCount, Lzw2Encoder(options, dictionary));
+
+   std::vector<ArchiveJob> jobs(paths.size());
+   std::size_t window = threadCount * ARCHIVE_WINDOW_PER_THREAD;
+   std::size_t next = 0;    // next file to hand out
+   std::size_t written = 0; // files written to the archive
+   bool stop = false;
+   std::mutex lock;
+   std::condition_variable jobDone;
+   std::condition_variable windowMoved;
+
+   std::vector<std::thread> workers;
+   for (unsigned t = 0; t < threadCount; ++t)
+   {
+      workers.push_back(std::thread([&, t]()
+      {
+         for (;;)
+         {
+            std::size_t i;
+            {
+               std::unique_lock<std::mutex> guard(lock);
+               windowMoved.wait(guard, [&]() { return stop || next == paths.size() || next < written + window; });
+               if (stop || next == paths.size())
+               {
+                  return;
+               }
+               i = next++;
+            }
+
+            // only this worker touches job i until it is marked done
+            ArchiveJob &job = jobs[i];
+            try
+            {
+               MappedFile input;
+               if (!input.open(directory + "/" + paths[i]))
+               {
+                  throw "Unable to open file to archive";
+               }
+               encoders[t].compress(input.data(), input.size(), job.stream);
+               job.uncompressedSize = input.size();
+            }
+            catch (const char *error)
+            {
+               job.error = error;
+            }
+            catch (const std::exception &)
+            {
+               // bad_alloc, length_error, ... must not escape the thread
+               job.error = "Unable to compress file to archive";
+            }
+
+            std::lock_guard<std::mutex> guard(lock);
+            job.done = true;
+            jobDone.notify_all();
+         }
+      }));
+   }
+
+   // write the streams in order as they finish
+   std::vector<ArchiveMember> members;
+   std::uint64_t offset = LZWA_HEADER_SIZE;
+   const char *failure = NULL;
+   for (std::size_t i = 0; i < paths.size() && failure == NULL; ++i)
+   {
+      std::vector<unsigned char> stream;
+      {
+         std::unique_lock<std::mutex> guard(lock);
+         jobDone.wait(guard, [&]() { return jobs[i].done; });
+         stream.swap(jobs[i].stream);
+         failure = jobs[i].error;
+      }
+
+      if (failure == NULL)
+      {
+         ArchiveMember member = { paths[i], offset, stream.size(), jobs[i].uncompressedSize };
+         members.push_back(member);
+         offset += stream.size();
+         if (!archive.write(stream.data(), stream.size()))
+         {
+            failure = "Unable to write lzw archive";
+         }
+      }
+
+      std::lock_guard<std::mutex> guard(lock);
+      written = i + 1;
+      stop = failure != NULL;
+      windowMoved.notify_all();
+   }
+
+   for (std::size_t t = 0; t < workers.size(); ++t)
+   {
+      workers[t].join();
+   }
+   if (failure != NULL)
+   {
+      throw failure;
+   }
+
+   std::vector<unsigned char> toc;
+   writeArchiveToc(toc, members);
+   std::vector<unsigned char> trailer;
+   writeLittleEndian(trailer, offset, 8);
+   writeLittleEndian(trailer, members.size(), 4);
+   writeLittleEndian(trailer, crc32c(toc.data(), toc.size()), 4);
+   if (!archive.write(toc.data(), toc.size()) || !archive.write(trailer.data(), trailer.size()) || !archive.close())
+   {
+      throw "Unable to write lzw archive";
+   }
+
+   return members;
+}
+
+/* READING */
+
+// Load and check the table of contents of an archive held in memory (usually a mapped file).
+inline std::vector<ArchiveMember> readArchiveToc(const unsigned char *data, std::size_t size)
+{
+   if (size < (std::size_t) (LZWA_HEADER_SIZE + LZWA_TRAILER_SIZE) || !std::equal(LZWA_MAGIC, LZWA_MAGIC + 4, (const char *) data))
+   {
+      throw "Bad lzw archive header";
+   }
+   if (data[4] != LZWA_VERSION)
+   {
+      throw "Unsupported lzw archive version";
+   }
+
+   const unsigned char *trailer = data + size - LZWA_TRAILER_SIZE;
+   std::uint64_t tocOffset = readLittleEndian(trailer, 8);
+   std::uint64_t count = readLittleEndian(trailer + 8, 4);
+   std::uint64_t tocEnd = size - LZWA_TRAILER_SIZE;
+   if (tocOffset < (std::uint64_t) LZWA_HEADER_SIZE || tocOffset > tocEnd)
+   {
+      throw "Bad lzw archive trailer";
+   }
+   if (crc32c(data + tocOffset, tocEnd - tocOffset) != readLittleEndian(trailer + 12, 4))
+   {
+      throw "Corrupt lzw archive table of contents";
+   }
+
+   std::vector<ArchiveMember> members;
+   std::uint64_t position = tocOffset;
+   for (std::uint64_t i = 0; i < count; ++i)
+   {
+      if (tocEnd - position < 2)
+      {
+         throw "Bad lzw archive table of contents";
+      }
+      std::size_t pathLength = readLittleEndian(data + position, 2);
+      if (tocEnd - position < 2 + pathLength + (LZWA_ENTRY_FIXED_SIZE - 2))
+      {
+         throw "Bad lzw archive table of contents";
+      }
+
+      const unsigned char *entry = data + position + 2 + pathLength;
+      ArchiveMember member;
+      member.path.assign((const char *) data + position + 2, pathLength);
+      member.offset = readLittleEndian(entry, 8);
+      member.compressedSize = readLittleEndian(entry + 8, 8);
+      member.uncompressedSize = readLittleEndian(entry + 16, 8);
+      if (member.offset < (std::uint64_t) LZWA_HEADER_SIZE || member.offset > tocOffset || member.compressedSize > tocOffset - member.offset)
+      {
+         throw "Bad lzw archive member offset";
+      }
+      members.push_back(member);
+      position += LZWA_ENTRY_FIXED_SIZE + pathLength;
+   }
+   if (position != tocEnd)
+   {
+      throw "Bad lzw archive table of contents";
+   }
+
+   return members;
+}
+
+// a stored path is only extracted if it stays below the output directory
+inline bool isSafeArchivePath(const std::string &path)
+{
+   if (path.empty() || path[0] == '/')
+   {
+      return false;
+   }
+   std::size_t start = 0;
+   for (;;)
+   {
+      std::size_t slash = path.find('/', start);
+      std::string part = path.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+      if (part.empty() || part == "." || part == "..")
+      {
+         return false;
+      }
+      if (slash == std::string::npos)
+      {
+         return true;
+      }
+      start = slash + 1;
+   }
+}
+
+// Decode member of the archive in data, replacing the contents of out.
+inline void readArchiveMember(const unsigned char *data, const ArchiveMember &member, Lzw2Decoder &decoder, std::vector<unsigned char> &out)
+{
+   decoder.decompress(data + member.offset, member.compressedSize, out);
+   if (out.size() != member.uncompressedSize)
+   {
+      throw "Corrupt lzw archive member (wrong size)";
+   }
+}
+
+// Extract members of the archive in data below directory (created as needed), threadCount files at a time.
+inline void extractArchive(const unsigned char *data, const std::vector<ArchiveMember> &members, const std::string &directory,
+                           const Lzw2Dictionary *dictionary, unsigned threadCount)
+{
+   for (std::size_t i = 0; i < members.size(); ++i)
+   {
+      if (!isSafeArchivePath(members[i].path))
+      {
+         throw "Unsafe path in lzw archive";
+      }
+   }
+
+   threadCount = std::max(1u, std::min<unsigned>(threadCount, std::max<std::size_t>(members.size(), 1)));
+
+   // the workers share the dictionary, which builds its primed tables on first use without a lock: build them
+   // here, before any worker starts. members written with different parameters (a never writes such archives)
+   // would have the tables rebuilt under the workers' feet, so those are extracted on one thread
+   if (dictionary != NULL)
+   {
+      Lzw2Options first;
+      bool primed = false;
+      for (std::size_t i = 0; i < members.size() && threadCount > 1; ++i)
+      {
+         Lzw2Options options = readLzw2Header(data + members[i].offset, members[i].compressedSize, dictionary);
+         if (!options.presetDictionary)
+         {
+            continue;
+         }
+         if (!primed)
+         {
+            first = options;
+            primed = true;
+         }
+         else if (options.maxCodeWidth != first.maxCodeWidth || options.clearCodes != first.clearCodes || options.growth != first.growth)
+         {
+            threadCount = 1;
+         }
+      }
+   }
+
+   std::atomic<std::size_t> next(0);
+   std::atomic<bool> stop(false);
+   std::vector<const char *> failures(threadCount, (const char *) NULL);
+
+   std::vector<std::thread> workers;
+   for (unsigned t = 0; t < threadCount; ++t)
+   {
+      workers.push_back(std::thread([&, t]()
+      {
+         Lzw2Decoder decoder(dictionary);
+         std::vector<unsigned char> contents;
+         try
+         {
+            for (std::size_t i = next++; i < members.size() && !stop; i = next++)
+            {
+               readArchiveMember(data, members[i], decoder, contents);
+               std::string path = directory + "/" + members[i].path;
+               if (!makeParentDirectories(path) || !writeWholeFile(path, contents.data(), contents.size()))
+               {
+                  throw "Unable to write extracted file";
+               }
+            }
+         }
+         catch (const char *error)
+         {
+            failures[t] = error;
+            stop = true;
+         }
+         catch (const std::exception &)
+         {
+            failures[t] = "Unable to extract file from archive";
+            stop = true;
+         }
+      }));
+   }
+
+   for (std::size_t t = 0; t < workers.size(); ++t)
+   {
+      workers[t].join();
+   }
+   for (std::size_t t = 0; t < failures.size(); ++t)
+   {
+      if (failures[t] != NULL)
+      {
+         throw failures[t];
+      }
+   }
+}
+
+#endif
@@ -0,0 +1,551 @@
+/*
+   lzwBenchmark435.cpp
+
+   throughput and ratio benchmark for the lzw codec
+
+   run with -> ./lzwBenchmark435 [--sizes=<KiB,KiB,...>] [--repeat=<n>] [--no-reference] [--csv]
+
+   a reproducible corpus (fixed seed) of five kinds of data is generated at several sizes:
+
+      text        words drawn from a skewed vocabulary, with punctuation and line breaks
+      logs        timestamped service log lines
+      random      uniformly random bytes (incompressible)
+      repetitive  a short pattern repeated with rare mutations
+      binary      fixed-size little-endian records of slowly changing integers and floats
+
+   each codec configuration compresses and decompresses every input; the best of --repeat runs is reported
+   as MB/s (1 MB = 2^20 bytes of uncompressed data), together with the compression ratio
+   (uncompressed / compressed) and the peak resident set size of the run.
+   every configuration runs in its own child process so its peak RSS is not polluted by the others.
+
+   the "reference" configuration is the original std::map based codec this project started from,
+   so every optimization is measured against the same baseline.
+
+   the "-hash" configurations run the same streams through the packed hash table encoder (LzwHashTable)
+   instead of the trie; their output is identical, so only compression speed differs.
+
+   the "lzw2-dict" configuration uses a preset dictionary trained on other samples of the same kind;
+   run with small --sizes (1 or 4 KiB) to see what it does for short messages.
+*/
+
+#include "lzwContainer435M.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* REFERENCE CODEC (the original RosettaCode derived implementation) */
+
+namespace reference
+{
+   template <typename Iterator>
+   Iterator compress(const std::string &uncompressed, Iterator result)
+   {
+      int dictSize = 256;
+      std::map<std::string, int> dictionary;
+      for (int i = 0; i < dictSize; ++i)
+      {
+         dictionary[std::string(1, i)] = i;
+      }
+
+      std::string w;
+      for (std::string::const_iterator it = uncompressed.begin(); it != uncompressed.end(); ++it)
+      {
+         char c = *it;
+         std::string wc = w + c;
+         if (dictionary.count(wc))
+         {
+            w = wc;
+         }
+         else
+         {
+            *result++ = dictionary[w];
+            if (dictionary.size() < 65536)
+            {
+               dictionary[wc] = dictSize++;
+            }
+            w = std::string(1, c);
+         }
+      }
+
+      if (!w.empty())
+      {
+         *result++ = dictionary[w];
+      }
+      return result;
+   }
+
+   template <typename Iterator>
+   std::string decompress(Iterator begin, Iterator end)
+   {
+      int dictSize = 256;
+      std::map<int, std::string> dictionary;
+      for (int i = 0; i < dictSize; ++i)
+      {
+         dictionary[i] = std::string(1, i);
+      }
+
+      std::string w(1, *begin++);
+      std::string result = w;
+      std::string entry;
+      for (; begin != end; begin++)
+      {
+         int k = *begin;
+         if (dictionary.count(k))
+         {
+            entry = dictionary[k];
+         }
+         else if (k == dictSize)
+         {
+            entry = w + w[0];
+         }
+         else
+         {
+            throw "Bad compressed k";
+         }
+         result += entry;
+         if (dictionary.size() < 65536)
+         {
+            dictionary[dictSize++] = w + entry[0];
+         }
+         w = entry;
+      }
+      return result;
+   }
+}
+
+/* CODEC CONFIGURATIONS */
+
+typedef std::vector<unsigned char> Bytes;
+
+struct BenchCodec
+{
+   std::string name;
+   Lzw2Options options; // ignored by the reference codec
+   bool isReference;
+   bool trainedDictionary; // compress with a dictionary trained on other data of the same kind
+   Lzw2Dictionary dictionary;
+
+   BenchCodec() : isReference(false), trainedDictionary(false) {}
+};
+
+// largest code the reference decoder can see as its i-th code
+int referenceBound(std::size_t i)
+{
+   return i == 0 ? 255 : (int) std::min<std::size_t>(256 + i - 1, 65535);
+}
+
+Bytes compressWith(const BenchCodec &codec, const Bytes &input)
+{
+   if (codec.isReference)
+   {
+      // same variable-width packing as Part 2, without a container
+      std::vector<int> codes;
+      reference::compress(std::string(input.begin(), input.end()), std::back_inserter(codes));
+      // the reference dictionary gains one entry per code after the first, up to 65,536
+      Bytes packed;
+      CodePacker<Bytes> packer(packed, LZW_MIN_CODE_WIDTH);
+      for (std::size_t i = 0; i < codes.size(); ++i)
+      {
+         packer(codes[i], referenceBound(i));
+      }
+      packer.flush();
+      return packed;
+   }
+
+   Bytes packed;
+   writeLzw2(packed, input.data(), input.size(), codec.options, codec.trainedDictionary ? &codec.dictionary : NULL);
+   return packed;
+}
+
+Bytes decompressWith(const BenchCodec &codec, const Bytes &packed)
+{
+   if (codec.isReference)
+   {
+      std::vector<int> codes;
+      CodeUnpacker unpacker(packed.data(), packed.size(), LZW_MIN_CODE_WIDTH);
+      int code;
+      while (unpacker(referenceBound(codes.size()), code))
+      {
+         codes.push_back(code);
+      }
+      if (codes.empty())
+      {
+         return Bytes();
+      }
+      std::string result = reference::decompress(codes.begin(), codes.end());
+      return Bytes(result.begin(), result.end());
+   }
+
+   return readLzw2(packed.data(), packed.size(), codec.trainedDictionary ? &codec.dictionary : NULL);
+}
+
+std::vector<BenchCodec> benchCodecs(bool withReference)
+{
+   std::vector<BenchCodec> codecs;
+
+   if (withReference)
+   {
+      BenchCodec reference;
+      reference.name = "reference";
+      reference.isReference = true;
+      codecs.push_back(reference);
+   }
+
+   BenchCodec current;
+   current.name = "lzw2";
+   codecs.push_back(current);
+
+   BenchCodec hashed = current;
+   hashed.name = "lzw2-hash";
+   hashed.options.hashedEncoder = true;
+   codecs.push_back(hashed);
+
+   BenchCodec wide = current;
+   wide.name = "lzw2-20bit";
+   wide.options.maxCodeWidth = 20;
+   codecs.push_back(wide);
+
+   BenchCodec wideHashed = wide;
+   wideHashed.name = "lzw2-20bit-hash";
+   wideHashed.options.hashedEncoder = true;
+   codecs.push_back(wideHashed);
+
+   BenchCodec indexed = current;
+   indexed.name = "lzw2-indexed";
+   indexed.options.indexed = true;
+   codecs.push_back(indexed);
+
+   BenchCodec ranged = current;
+   ranged.name = "lzw2-range";
+   ranged.options.rangeCoded = true;
+   codecs.push_back(ranged);
+
+   BenchCodec lzmw = current;
+   lzmw.name = "lzw2-lzmw";
+   lzmw.options.growth = GROWTH_LZMW;
+   codecs.push_back(lzmw);
+
+   BenchCodec lzap = current;
+   lzap.name = "lzw2-lzap";
+   lzap.options.growth = GROWTH_LZAP;
+   codecs.push_back(lzap);
+
+   BenchCodec trained = current;
+   trained.name = "lzw2-dict";
+   trained.trainedDictionary = true;
+   codecs.push_back(trained);
+
+   return codecs;
+}
+
+/* CORPUS */
+
+Bytes generateText(std::size_t size, std::mt19937 &rng)
+{
+   static const char *words[] = {
+      "the", "of", "and", "to", "in", "a", "is", "that", "for", "it", "as", "was", "with", "be", "by", "on",
+      "not", "he", "this", "are", "or", "his", "from", "at", "which", "but", "have", "an", "had", "they",
+      "algorithm", "dictionary", "compression", "sequence", "string", "entropy", "variable", "length",
+      "code", "word", "symbol", "prefix", "table", "stream", "output", "input", "encoder", "decoder" };
+   const int wordCount = sizeof(words) / sizeof(words[0]);
+
+   // skewed choice: small indices (common words) are much more likely
+   std::geometric_distribution<int> pick(0.08);
+   std::uniform_int_distribution<int> punctuation(0, 19);
+
+   Bytes result;
+   while (result.size() < size)
+   {
+      const char *word = words[pick(rng) % wordCount];
+      result.insert(result.end(), word, word + std::strlen(word));
+      int p = punctuation(rng);
+      result.push_back(p == 0 ? '.' : (p == 1 ? ',' : (p == 2 ? '\n' : ' ')));
+   }
+   result.resize(size);
+   return result;
+}
+
+Bytes generateLogs(std::size_t size, std::mt19937 &rng)
+{
+   static const char *levels[] = { "INFO", "INFO", "INFO", "DEBUG", "WARN", "ERROR" };
+   static const char *paths[] = { "/api/v1/users", "/api/v1/orders", "/api/v2/search", "/healthz", "/api/v1/cart/items" };
+   std::uniform_int_distribution<int> level(0, 5), path(0, 4), worker(0, 15), status(0, 9), latency(1, 900);
+   std::uniform_int_distribution<unsigned> requestId;
+
+   Bytes result;
+   long millis = 0;
+   char line[256];
+   while (result.size() < size)
+   {
+      millis += latency(rng) / 10;
+      int length = std::snprintf(line, sizeof(line),
+         "2024-03-%02ld %02ld:%02ld:%02ld.%03ld %s [worker-%d] request id=%08x path=%s status=%d latency=%dms\n",
+         1 + millis / 86400000 % 28, millis / 3600000 % 24, millis / 60000 % 60, millis / 1000 % 60, millis % 1000,
+         levels[level(rng)], worker(rng), requestId(rng), paths[path(rng)], status(rng) == 0 ? 500 : 200, latency(rng));
+      result.insert(result.end(), line, line + length);
+   }
+   result.resize(size);
+   return result;
+}
+
+Bytes generateRandom(std::size_t size, std::mt19937 &rng)
+{
+   Bytes result(size);
+   for (std::size_t i = 0; i < size; ++i)
+   {
+      result[i] = (unsigned char) (rng() & 255);
+   }
+   return result;
+}
+
+Bytes generateRepetitive(std::size_t size, std::mt19937 &rng)
+{
+   const std::string pattern = "ABABABABCABCABCDABCDEABCDEF0123456789";
+   std::uniform_int_distribution<int> mutate(0, 999);
+
+   Bytes result(size);
+   for (std::size_t i = 0; i < size; ++i)
+   {
+      result[i] = mutate(rng) == 0 ? (unsigned char) (rng() & 255) : (unsigned char) pattern[i % pattern.size()];
+   }
+   return result;
+}
+
+Bytes generateBinary(std::size_t size, std::mt19937 &rng)
+{
+   std::normal_distribution<float> noise(0.0f, 0.05f);
+   std::uniform_int_distribution<int> flags(0, 7);
+
+   Bytes result;
+   std::uint32_t id = 1000;
+   std::uint16_t counter = 0;
+   float reading = 20.0f;
+   while (result.size() < size)
+   {
+      // 16 byte record: id, counter, flags, pad, reading, reserved (zeros)
+      unsigned char record[16] = { 0 };
+      ++id;
+      counter += flags(rng) == 0 ? 2 : 1;
+      reading += noise(rng);
+      std::memcpy(record, &id, 4);
+      std::memcpy(record + 4, &counter, 2);
+      record[6] = (unsigned char) flags(rng);
+      std::memcpy(record + 8, &reading, 4);
+      result.insert(result.end(), record, record + 16);
+   }
+   result.resize(size);
+   return result;
+}
+
+struct CorpusKind
+{
+   const char *name;
+   Bytes (*generate)(std::size_t, std::mt19937 &);
+};
+
+const CorpusKind CORPUS[] = {
+   { "text", generateText },
+   { "logs", generateLogs },
+   { "random", generateRandom },
+   { "repetitive", generateRepetitive },
+   { "binary", generateBinary } };
+
+const int DICTIONARY_SAMPLE_COUNT = 32;        // samples the lzw2-dict dictionaries are trained on
+const std::size_t DICTIONARY_SAMPLE_SIZE = 4096;
+
+/* MEASUREMENT */
+
+struct BenchResult
+{
+   double compressSeconds;
+   double decompressSeconds;
+   std::size_t compressedSize;
+   bool roundTripOk;
+   long peakRssKiB;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+   return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// run codec on input in a child process and collect its timings and peak RSS
+bool measure(const BenchCodec &codec, const Bytes &input, int repeat, BenchResult &result)
+{
+   int channel[2];
+   if (pipe(channel) != 0)
+   {
+      return false;
+   }
+
+   pid_t child = fork();
+   if (child < 0)
+   {
+      return false;
+   }
+
+   if (child == 0)
+   {
+      close(channel[0]);
+      BenchResult timing;
+      timing.compressSeconds = timing.decompressSeconds = 1e30;
+      timing.roundTripOk = true;
+
+      try
+      {
+         for (int run = 0; run < repeat; ++run)
+         {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            Bytes packed = compressWith(codec, input);
+            timing.compressSeconds = std::min(timing.compressSeconds, secondsSince(start));
+            timing.compressedSize = packed.size();
+
+            start = std::chrono::steady_clock::now();
+            Bytes restored = decompressWith(codec, packed);
+            timing.decompressSeconds = std::min(timing.decompressSeconds, secondsSince(start));
+            timing.roundTripOk = timing.roundTripOk && restored == input;
+         }
+      } catch (const char *) {
+         timing.roundTripOk = false;
+      }
+
+      ssize_t written = write(channel[1], &timing, sizeof(timing));
+      _exit(written == (ssize_t) sizeof(timing) ? 0 : 1);
+   }
+
+   close(channel[1]);
+   ssize_t received = read(channel[0], &result, sizeof(result));
+   close(channel[0]);
+
+   int status = 0;
+   struct rusage usage;
+   if (wait4(child, &status, 0, &usage) != child || received != (ssize_t) sizeof(result) || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+   {
+      return false;
+   }
+
+   result.peakRssKiB = usage.ru_maxrss; // kilobytes on Linux
+   return true;
+}
+
+int main(int argc, char* argv[])
+{
+   std::vector<std::size_t> sizesKiB;
+   sizesKiB.push_back(64);
+   sizesKiB.push_back(1024);
+   sizesKiB.push_back(8192);
+   int repeat = 3;
+   bool withReference = true;
+   bool csv = false;
+
+   for (int i = 1; i < argc; ++i)
+   {
+      std::string flag(argv[i]);
+      if (flag.compare(0, 8, "--sizes=") == 0)
+      {
+         sizesKiB.clear();
+         std::stringstream list(flag.substr(8));
+         std::string item;
+         while (std::getline(list, item, ','))
+         {
+            sizesKiB.push_back(std::strtoull(item.c_str(), NULL, 10));
+         }
+      }
+      else if (flag.compare(0, 9, "--repeat=") == 0)
+      {
+         repeat = std::max(1, std::atoi(flag.c_str() + 9));
+      }
+      else if (flag == "--no-reference")
+      {
+         withReference = false;
+      }
+      else if (flag == "--csv")
+      {
+         csv = true;
+      }
+      else
+      {
+         std::cerr << "Error: unrecognized flag '" << flag << "'\n"
+                   << "Required Format: ./lzwBenchmark435 [--sizes=<KiB,KiB,...>] [--repeat=<n>] [--no-reference] [--csv]" << std::endl;
+         return 1;
+      }
+   }
+
+   std::vector<BenchCodec> codecs = benchCodecs(withReference);
+
+   if (csv)
+   {
+      std::printf("corpus,size_bytes,codec,ratio,compress_mb_s,decompress_mb_s,peak_rss_kib,round_trip\n");
+   }
+   else
+   {
+      std::printf("%-11s %10s  %-16s %7s %12s %12s %12s\n", "corpus", "size", "codec", "ratio", "comp MB/s", "decomp MB/s", "peak RSS MB");
+   }
+
+   bool allOk = true;
+   for (std::size_t k = 0; k < sizeof(CORPUS) / sizeof(CORPUS[0]); ++k)
+   {
+      // dictionaries are trained on other samples of the same kind (another seed) and primed up front,
+      // as a long running process compressing many messages would
+      std::mt19937 trainingRng(4350);
+      std::vector<Bytes> samples;
+      for (int i = 0; i < DICTIONARY_SAMPLE_COUNT; ++i)
+      {
+         samples.push_back(CORPUS[k].generate(DICTIONARY_SAMPLE_SIZE, trainingRng));
+      }
+      Lzw2Dictionary dictionary = trainDictionary(samples);
+      for (std::size_t c = 0; c < codecs.size(); ++c)
+      {
+         if (codecs[c].trainedDictionary)
+         {
+            codecs[c].dictionary = dictionary;
+            codecs[c].dictionary.presetFor(codecs[c].options);
+         }
+      }
+
+      for (std::size_t s = 0; s < sizesKiB.size(); ++s)
+      {
+         // the same seed for every kind and size keeps the corpus reproducible across runs
+         std::mt19937 rng(435);
+         Bytes input = CORPUS[k].generate(sizesKiB[s] * 1024, rng);
+         double megabytes = input.size() / (1024.0 * 1024.0);
+
+         for (std::size_t c = 0; c < codecs.size(); ++c)
+         {
+            BenchResult result;
+            if (!measure(codecs[c], input, repeat, result))
+            {
+               std::fprintf(stderr, "Error: benchmark run of '%s' on %s failed\n", codecs[c].name.c_str(), CORPUS[k].name);
+               allOk = false;
+               continue;
+            }
+            allOk = allOk && result.roundTripOk;
+
+            double ratio = result.compressedSize ? (double) input.size() / result.compressedSize : 0.0;
+            if (csv)
+            {
+               std::printf("%s,%zu,%s,%.4f,%.2f,%.2f,%ld,%s\n", CORPUS[k].name, input.size(), codecs[c].name.c_str(), ratio,
+                  megabytes / result.compressSeconds, megabytes / result.decompressSeconds, result.peakRssKiB,
+                  result.roundTripOk ? "ok" : "FAILED");
+            }
+            else
+            {
+               std::printf("%-11s %10zu  %-16s %7.3f %12.2f %12.2f %12.1f%s\n", CORPUS[k].name, input.size(), codecs[c].name.c_str(), ratio,
+                  megabytes / result.compressSeconds, megabytes / result.decompressSeconds, result.peakRssKiB / 1024.0,
+                  result.roundTripOk ? "" : "  ROUND TRIP FAILED");
+            }
+            std::fflush(stdout);
+         }
+      }
+   }
+
+   return allOk ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+/*
+    lzwChecksum435M.hpp
+
+    block checksums for the .lzw2 container of lzw compression Part 2
+
+    every block of a .lzw2 stream carries the CRC32C (Castagnoli polynomial, as in iSCSI and ext4) of its
+    uncompressed bytes. x86 processors with SSE4.2 compute it in hardware 8 bytes at a time, many times faster
+    than the decoder produces output, so checking it costs next to nothing. elsewhere a table driven
+    version processing 8 bytes per step (slicing-by-8) is used instead; both give the same result.
+
+    yes, I know I'm not supposed to put code in a header file
+*/
+
+#ifndef LZWCHECKSUM435M_HPP
+#define LZWCHECKSUM435M_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <nmmintrin.h>
+#define LZW_HAVE_HARDWARE_CRC32C 1
+#endif
+
+const std::uint32_t CRC32C_POLYNOMIAL = 0x82F63B78; // reversed Castagnoli polynomial
+
+/* SOFTWARE */
+
+// table[k][b] is the CRC of byte b followed by k zero bytes, so 8 bytes can be folded in with 8 lookups
+struct Crc32cTables
+{
+   std::uint32_t table[8][256];
+
+   Crc32cTables()
+   {
+      for (int b = 0; b < 256; ++b)
+      {
+         std::uint32_t crc = b;
+         for (int bit = 0; bit < 8; ++bit)
+         {
+            crc = (crc >> 1) ^ (CRC32C_POLYNOMIAL & (0 - (crc & 1)));
+         }
+         table[0][b] = crc;
+      }
+      for (int k = 1; k < 8; ++k)
+      {
+         for (int b = 0; b < 256; ++b)
+         {
+            table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 255];
+         }
+      }
+   }
+};
+
+inline std::uint32_t crc32cSoftware(std::uint32_t crc, const unsigned char *data, std::size_t size)
+{
+   static const Crc32cTables tables;
+   const std::uint32_t (*table)[256] = tables.table;
+
+   while (size >= 8)
+   {
+      // the CRC is defined little-endian, so assemble the words byte by byte
+      std::uint32_t low = crc ^ (data[0] | (data[1] << 8) | (data[2] << 16) | ((std::uint32_t) data[3] << 24));
+      crc = table[7][low & 255] ^ table[6][(low >> 8) & 255] ^ table[5][(low >> 16) & 255] ^ table[4][low >> 24]
+            ^ table[3][data[4]] ^ table[2][data[5]] ^ table[1][data[6]] ^ table[0][data[7]];
+      data += 8;
+      size -= 8;
+   }
+   while (size-- > 0)
+   {
+      crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 255];
+   }
+   return crc;
+}
+
+/* HARDWARE */
+
+#ifdef LZW_HAVE_HARDWARE_CRC32C
+
+__attribute__((target("sse4.2"))) inline std::uint32_t crc32cHardware(std::uint32_t crc, const unsigned char *data, std::size_t size)
+{
+#ifdef __x86_64__
+   std::uint64_t wide = crc;
+   while (size >= 8)
+   {
+      std::uint64_t word;
+      std::memcpy(&word, data, 8);
+      wide = _mm_crc32_u64(wide, word);
+      data += 8;
+      size -= 8;
+   }
+   crc = (std::uint32_t) wide;
+#endif
+   while (size >= 4)
+   {
+      std::uint32_t word;
+      std::memcpy(&word, data, 4);
+      crc = _mm_crc32_u32(crc, word);
+      data += 4;
+      size -= 4;
+   }
+   while (size-- > 0)
+   {
+      crc = _mm_crc32_u8(crc, *data++);
+   }
+   return crc;
+}
+
+#endif
+
+// CRC32C of size bytes starting at data. Pass the previous result as crc to continue a checksum over several pieces.
+inline std::uint32_t crc32c(const unsigned char *data, std::size_t size, std::uint32_t crc = 0)
+{
+   crc = ~crc;
+#ifdef LZW_HAVE_HARDWARE_CRC32C
+   // the build does not assume SSE4.2, so ask the processor once
+   static const bool hardware = __builtin_cpu_supports("sse4.2");
+   if (hardware)
+   {
+      return ~crc32cHardware(crc, data, size);
+   }
+#endif
+   return ~crc32cSoftware(crc, data, size);
+}
+
+#endif
@@ -0,0 +1,857 @@
+/*
+    lzwCodec435.hpp
+
+    contains the core algorithms invoked by drivers lzw435.cpp (Part 1) and lzw435M.cpp (Part 2)
+    and by the lzw library (lzwLibrary435M.hpp). nothing in here prints or touches files.
+
+    the codec works on raw bytes (unsigned char), so any file can be compressed, not only text.
+
+    both parts share one codec. the only difference between them used to be the dictionary limit
+    (4096 entries for Part 1, 65,536 for Part 2); that limit is now the runtime maximum code width,
+    anywhere from 9 to 24 bits, and the dictionary holds up to 2^maxCodeWidth entries.
+
+    how the dictionary grows is selectable:
+        LZW   adds w + c, the previous match plus the next character (the classic algorithm)
+        LZMW  adds prev + cur, the previous match followed by the whole current match
+        LZAP  adds prev + every prefix of cur (prev + cur[0], prev + cur[0..1], ..., prev + cur)
+    LZMW and LZAP grow the dictionary much faster on repetitive data at the cost of a slower encoder.
+
+    the encoder hands every code to a sink together with its "bound", the largest code the decoder could
+    see at that point. the decoder asks its code source for the next code with the same bound. a bit packer
+    uses the bound to choose the code width, which keeps the width in step with the dictionary no matter
+    how many entries each step adds.
+
+    the classic LZW encoder can look phrases up in a trie (the default) or in a packed hash table that stays
+    in cache for the usual dictionary sizes; both produce exactly the same codes.
+
+    yes, I know I'm not supposed to put code in a header file
+*/
+
+#ifndef LZWCODEC435_HPP
+#define LZWCODEC435_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <cstdint>
+
+/* This code is derived in parts from LZW@RosettaCode for UA CS435 */
+
+const int LZW_MIN_CODE_WIDTH = 9;          // code word length begins at 9
+const int LZW_MAX_CODE_WIDTH = 24;         // widest code word the codec supports (16,777,216 entries)
+const int CLEAR_CODE = 256;                // resets the dictionary in both encoder and decoder when clear codes are enabled
+const long CLEAR_CHECK_INTERVAL = 10000;   // input bytes between compression ratio checks once the dictionary is full
+const double CLEAR_RATIO_TOLERANCE = 0.9;  // clear when a window compresses worse than 90% of the best window
+
+enum GrowthPolicy
+{
+   GROWTH_LZW = 0,
+   GROWTH_LZMW = 1,
+   GROWTH_LZAP = 2
+};
+
+struct LzwPreset;
+
+// everything encoder and decoder have to agree on (and how the encoder finds its phrases, which they don't)
+struct LzwParameters
+{
+   int maxCodeWidth;       // the dictionary holds up to 2^maxCodeWidth entries
+   bool clearCodes;        // reserve code 256 as CLEAR
+   GrowthPolicy growth;    // which phrases are added to the dictionary after each match
+   const LzwPreset *preset; // dictionary to start from (and return to after a CLEAR) instead of the 256 single bytes
+   bool hashedEncoder;     // GROWTH_LZW only: encoder uses LzwHashTable instead of the trie, same codes either way
+
+   LzwParameters(int maxCodeWidth = 16, bool clearCodes = false, GrowthPolicy growth = GROWTH_LZW)
+      : maxCodeWidth(maxCodeWidth), clearCodes(clearCodes), growth(growth), preset(NULL), hashedEncoder(false) {}
+
+   int firstFreeCode() const { return clearCodes ? CLEAR_CODE + 1 : 256; }
+   int dictionaryLimit() const { return 1 << maxCodeWidth; }
+};
+
+// encoder dictionary: a trie whose children are kept in singly linked lists (firstChild -> nextSibling -> ...)
+struct LzwEncoderTables
+{
+   int dictSize;
+   std::vector<int> firstChild;
+   std::vector<int> nextSibling;
+   std::vector<unsigned char> lastByte;
+   std::vector<int> nodeCode;            // LZMW/LZAP only: code of the phrase ending at a node, -1 if none
+};
+
+// encoder dictionary for classic LZW as an open addressing table with linear probing. each slot packs a
+// phrase w + c and its code into 8 bytes:
+//     bits 63-40 : code of the prefix w (up to 24 bits)
+//     bits 39-32 : the byte c
+//     bits 31-0  : code of w + c
+// phrases always get codes of 256 and up, so an all-zero slot is empty. the table doubles whenever it is
+// 2/3 full, so a full 65,536 entry dictionary takes about 96K slots (768 KiB) and stays in L2, and a stream
+// that only ever learns a few phrases keeps a table that fits in L1. probing walks neighbouring slots,
+// usually within the cache line of the first one.
+class LzwHashTable
+{
+public:
+   LzwHashTable() : count(0) {}
+
+   // empty table with room for entries phrases before it has to grow
+   void reset(std::size_t entries)
+   {
+      slots.assign(entries + entries / 2 + 1, 0);
+      count = 0;
+   }
+
+   // code of phrase prefix + byte, -1 if it is not in the dictionary
+   int find(int prefix, unsigned char byte) const
+   {
+      std::uint64_t key = keyFor(prefix, byte);
+      for (std::size_t i = slotFor(key);; i = nextSlot(i))
+      {
+         std::uint64_t slot = slots[i];
+         if (slot == 0)
+         {
+            return -1;
+         }
+         if ((slot >> 32) == key)
+         {
+            return (int) (slot & 0xFFFFFFFF);
+         }
+      }
+   }
+
+   // add a phrase known not to be in the table
+   void insert(int prefix, unsigned char byte, int code)
+   {
+      if (3 * (count + 1) > 2 * slots.size())
+      {
+         grow();
+      }
+      place((keyFor(prefix, byte) << 32) | (std::uint32_t) code);
+      ++count;
+   }
+
+private:
+   static std::uint64_t keyFor(int prefix, unsigned char byte) { return ((std::uint64_t) prefix << 8) | byte; }
+
+   // multiplicative hash, scaled onto the table without a division
+   std::size_t slotFor(std::uint64_t key) const
+   {
+      std::uint32_t hash = (std::uint32_t) key * 0x9E3779B1u;
+      return (std::size_t) (((std::uint64_t) hash * slots.size()) >> 32);
+   }
+
+   std::size_t nextSlot(std::size_t i) const { return i + 1 == slots.size() ? 0 : i + 1; }
+
+   void place(std::uint64_t entry)
+   {
+      std::size_t i = slotFor(entry >> 32);
+      while (slots[i] != 0)
+      {
+         i = nextSlot(i);
+      }
+      slots[i] = entry;
+   }
+
+   // rehash into twice as many slots
+   void grow()
+   {
+      std::vector<std::uint64_t> old(2 * slots.size(), 0);
+      old.swap(slots);
+      for (std::size_t i = 0; i < old.size(); ++i)
+      {
+         if (old[i] != 0)
+         {
+            place(old[i]);
+         }
+      }
+   }
+
+   std::vector<std::uint64_t> slots;
+   std::size_t count;
+};
+
+// decoder dictionary: every phrase is a run of bytes already written to the output
+struct LzwDecoderTables
+{
+   int dictSize;
+   std::vector<std::size_t> offset;      // where the phrase starts in the output
+   std::vector<std::size_t> length;      // length of the phrase
+   std::vector<unsigned char> history;   // output the offsets of a preset point into
+};
+
+// the tables encoder and decoder are left with after running a primer through the codec, so a message
+// can start from a dictionary that already knows its typical phrases (see primeDictionary)
+struct LzwPreset
+{
+   LzwEncoderTables encoder;
+   LzwDecoderTables decoder;
+};
+
+inline bool isValidCodeWidth(int codeWidth)
+{
+   return codeWidth >= LZW_MIN_CODE_WIDTH && codeWidth <= LZW_MAX_CODE_WIDTH;
+}
+
+inline bool isValidGrowthPolicy(int growth)
+{
+   return growth == GROWTH_LZW || growth == GROWTH_LZMW || growth == GROWTH_LZAP;
+}
+
+// number of bits needed to write any code in [0, bound], never less than minWidth
+inline int codeWidthFor(int bound, int minWidth)
+{
+   int bits = minWidth;
+   while (bound >= (1 << bits))
+   {
+      ++bits;
+   }
+   return bits;
+}
+
+/* CODE SINKS AND SOURCES */
+
+// sink that drops the bounds and writes plain codes to an output iterator
+template <typename Iterator>
+struct IteratorCodeSink
+{
+   Iterator result;
+
+   explicit IteratorCodeSink(Iterator result) : result(result) {}
+   void operator()(int code, int /* bound */) { *result++ = code; }
+};
+
+// source that reads plain codes from the range [begin, end)
+template <typename Iterator>
+struct RangeCodeSource
+{
+   Iterator begin, end;
+
+   RangeCodeSource(Iterator begin, Iterator end) : begin(begin), end(end) {}
+   bool operator()(int /* bound */, int &code)
+   {
+      if (begin == end)
+      {
+         return false;
+      }
+      code = *begin++;
+      return true;
+   }
+};
+
+/* DICTIONARY TABLES */
+
+// the dictionary a stream starts from: the preset when there is one, otherwise the 256 single bytes
+// (nodes 0-255 are the single bytes, and with LZW every node is also the code of its phrase)
+inline void resetEncoderTables(LzwEncoderTables &tables, const LzwParameters &parameters)
+{
+   if (parameters.preset != NULL)
+   {
+      tables = parameters.preset->encoder;
+      return;
+   }
+
+   int nodes = parameters.growth == GROWTH_LZW ? parameters.firstFreeCode() : 256;
+   tables.dictSize = parameters.firstFreeCode();
+   tables.firstChild.assign(nodes, -1);
+   tables.nextSibling.assign(nodes, -1);
+   tables.lastByte.assign(nodes, 0);
+   tables.nodeCode.clear();
+   if (parameters.growth != GROWTH_LZW)
+   {
+      for (int i = 0; i < 256; ++i)
+      {
+         tables.nodeCode.push_back(i);
+      }
+   }
+}
+
+inline void resetDecoderTables(LzwDecoderTables &tables, const LzwParameters &parameters)
+{
+   if (parameters.preset != NULL)
+   {
+      tables = parameters.preset->decoder;
+      return;
+   }
+
+   // codes 0-255 are written as they are and never looked up
+   int firstFreeCode = parameters.firstFreeCode();
+   tables.dictSize = firstFreeCode;
+   tables.offset.assign(firstFreeCode, 0);
+   tables.length.assign(firstFreeCode, 1);
+   tables.history.clear();
+}
+
+/* ENCODER */
+
+// ratio watch shared by every growth policy: once the dictionary is full, compare the input bytes per code
+// of each CLEAR_CHECK_INTERVAL window against the best window since it filled, and ask for a CLEAR when a
+// window falls below CLEAR_RATIO_TOLERANCE of it.
+struct ClearMonitor
+{
+   long windowBytes;
+   long windowCodes;
+   double bestRatio;
+
+   ClearMonitor() : windowBytes(0), windowCodes(0), bestRatio(0.0) {}
+
+   // the dictionary grew, the window starts again
+   void restart() { windowBytes = windowCodes = 0; }
+
+   bool shouldClear()
+   {
+      if (windowBytes < CLEAR_CHECK_INTERVAL)
+      {
+         return false;
+      }
+
+      double ratio = (double) windowBytes / windowCodes;
+      bestRatio = std::max(bestRatio, ratio);
+      restart();
+
+      if (ratio < bestRatio * CLEAR_RATIO_TOLERANCE)
+      {
+         bestRatio = 0.0;
+         return true;
+      }
+      return false;
+   }
+};
+
+// classic LZW: the dictionary trie is prefix closed, so every trie node is a code and the
+// longest match can be found one character at a time without ever backing up
+template <typename CodeSink>
+void encodeLzw(const unsigned char *data, std::size_t size, CodeSink &sink, const LzwParameters &parameters, LzwEncoderTables &tables)
+{
+   // every phrase w + c is stored as the child (w, c) of phrase w
+   const int dictionaryLimit = parameters.dictionaryLimit();
+   int &dictSize = tables.dictSize;
+   std::vector<int> &firstChild = tables.firstChild;
+   std::vector<int> &nextSibling = tables.nextSibling;
+   std::vector<unsigned char> &lastByte = tables.lastByte;
+
+   // ratio monitoring state, only used once the dictionary stops growing
+   ClearMonitor monitor;
+
+   /* BUILD OUT THE DICTIONARY FOR INPUT STRING */
+
+   // code of the longest matching "prefix" for the next iteration, -1 while empty
+   int w = -1;
+
+   // loop through each byte of the uncompressed input
+   for (const unsigned char *it = data; it != data + size; ++it)
+   {
+      // store byte at this iteration
+      unsigned char c = *it;
+      ++monitor.windowBytes;
+
+      if (w < 0)
+      {
+         // every single character is in the dictionary
+         w = c;
+         continue;
+      }
+
+      // look for w + c among the children of w
+      int wc = firstChild[w];
+      while (wc >= 0 && lastByte[wc] != c)
+      {
+         wc = nextSibling[wc];
+      }
+
+      if (wc >= 0)
+      {
+         // if already in dictionary, this is the new longest prefix
+         w = wc;
+         continue;
+      }
+
+      // if not already in dictionary
+      // write code for previous longest prefix to output buffer and increment for next iteration.
+      // the decoder is one entry behind us, but may see the entry it is about to add (the KwKwK case)
+      sink(w, dictSize - 1);
+      ++monitor.windowCodes;
+
+      // Add wc to the dictionary while there is room for it
+      if (dictSize < dictionaryLimit)
+      {
+         firstChild.push_back(-1);
+         nextSibling.push_back(firstChild[w]);
+         lastByte.push_back(c);
+         firstChild[w] = dictSize++;
+         monitor.restart();
+      }
+      else if (parameters.clearCodes && monitor.shouldClear())
+      {
+         // the dictionary no longer fits the input, start over
+         sink(CLEAR_CODE, dictSize - 1);
+         resetEncoderTables(tables, parameters);
+      }
+
+      // new longest prefix is the current character
+      w = c;
+   }
+
+   // Output the code for w.
+   if (w >= 0)
+   {
+      sink(w, dictSize - 1);
+   }
+}
+
+const std::size_t LZW_HASH_INITIAL_ENTRIES = 4096; // phrases a hash table holds before it first grows (48 KiB)
+
+// empty the table and load the phrases of trie (an LZW trie, where nodes are codes), if given
+inline void resetHashTable(LzwHashTable &table, const LzwEncoderTables *trie)
+{
+   table.reset(std::max<std::size_t>(LZW_HASH_INITIAL_ENTRIES, trie != NULL ? trie->dictSize : 0));
+   if (trie == NULL)
+   {
+      return;
+   }
+
+   for (int w = 0; w < trie->dictSize; ++w)
+   {
+      for (int wc = trie->firstChild[w]; wc >= 0; wc = trie->nextSibling[wc])
+      {
+         table.insert(w, trie->lastByte[wc], wc);
+      }
+   }
+}
+
+// classic LZW with the phrases in an LzwHashTable instead of the trie. emits exactly the codes of encodeLzw,
+// starting from the dictionary in tables (which is left as it was)
+template <typename CodeSink>
+void encodeLzwHashed(const unsigned char *data, std::size_t size, CodeSink &sink, const LzwParameters &parameters, const LzwEncoderTables &tables)
+{
+   const int dictionaryLimit = parameters.dictionaryLimit();
+   int dictSize = tables.dictSize;
+
+   LzwHashTable table;
+   resetHashTable(table, &tables);
+
+   // what a CLEAR returns to
+   const LzwEncoderTables *preset = parameters.preset != NULL ? &parameters.preset->encoder : NULL;
+
+   ClearMonitor monitor;
+   int w = -1;
+
+   for (const unsigned char *it = data; it != data + size; ++it)
+   {
+      unsigned char c = *it;
+      ++monitor.windowBytes;
+
+      if (w < 0)
+      {
+         w = c;
+         continue;
+      }
+
+      int wc = table.find(w, c);
+      if (wc >= 0)
+      {
+         w = wc;
+         continue;
+      }
+
+      sink(w, dictSize - 1);
+      ++monitor.windowCodes;
+
+      if (dictSize < dictionaryLimit)
+      {
+         table.insert(w, c, dictSize++);
+         monitor.restart();
+      }
+      else if (parameters.clearCodes && monitor.shouldClear())
+      {
+         sink(CLEAR_CODE, dictSize - 1);
+         resetHashTable(table, preset);
+         dictSize = preset != NULL ? preset->dictSize : parameters.firstFreeCode();
+      }
+
+      w = c;
+   }
+
+   if (w >= 0)
+   {
+      sink(w, dictSize - 1);
+   }
+}
+
+// LZMW and LZAP: new phrases are not prefix closed (prev + cur does not imply prev + cur[0]), so trie nodes
+// and codes are kept apart. nodes 0-255 are the single bytes; other nodes only carry a code if some phrase
+// ends there. the longest match walks the trie as far as it goes and backs up to the last node with a code.
+template <typename CodeSink>
+void encodeMultiPhrase(const unsigned char *data, std::size_t size, CodeSink &sink, const LzwParameters &parameters, LzwEncoderTables &tables)
+{
+   const int dictionaryLimit = parameters.dictionaryLimit();
+   int &dictSize = tables.dictSize;
+   std::vector<int> &firstChild = tables.firstChild;
+   std::vector<int> &nextSibling = tables.nextSibling;
+   std::vector<unsigned char> &lastByte = tables.lastByte;
+   std::vector<int> &nodeCode = tables.nodeCode;
+
+   ClearMonitor monitor;
+
+   // node of the previous match, -1 at the start and right after a CLEAR
+   int previousNode = -1;
+
+   std::size_t position = 0;
+   while (position < size)
+   {
+      // longest match starting at position
+      int node = data[position];
+      int matchCode = node;
+      int matchNode = node;
+      std::size_t matchLength = 1;
+      for (std::size_t j = position + 1; j < size; ++j)
+      {
+         int child = firstChild[node];
+         while (child >= 0 && lastByte[child] != data[j])
+         {
+            child = nextSibling[child];
+         }
+         if (child < 0)
+         {
+            break;
+         }
+
+         node = child;
+         if (nodeCode[node] >= 0)
+         {
+            matchCode = nodeCode[node];
+            matchNode = node;
+            matchLength = j - position + 1;
+         }
+      }
+
+      // no KwKwK case here: new phrases are added only after both matches are known to the decoder
+      sink(matchCode, dictSize - 1);
+      monitor.windowBytes += matchLength;
+      ++monitor.windowCodes;
+
+      // add prev + cur (LZMW) or prev + each prefix of cur (LZAP) by extending the trie from prev.
+      // a phrase that already has a code still uses up a new code, exactly as in the decoder, which
+      // cannot tell the duplicate apart
+      if (previousNode >= 0 && dictSize < dictionaryLimit)
+      {
+         int extend = previousNode;
+         for (std::size_t j = position; j < position + matchLength && dictSize < dictionaryLimit; ++j)
+         {
+            int child = firstChild[extend];
+            while (child >= 0 && lastByte[child] != data[j])
+            {
+               child = nextSibling[child];
+            }
+            if (child < 0)
+            {
+               child = firstChild.size();
+               firstChild.push_back(-1);
+               nextSibling.push_back(firstChild[extend]);
+               lastByte.push_back(data[j]);
+               nodeCode.push_back(-1);
+               firstChild[extend] = child;
+            }
+            extend = child;
+
+            if (parameters.growth == GROWTH_LZAP || j + 1 == position + matchLength)
+            {
+               if (nodeCode[extend] < 0)
+               {
+                  nodeCode[extend] = dictSize;
+               }
+               ++dictSize;
+            }
+         }
+         monitor.restart();
+      }
+      else if (previousNode >= 0 && parameters.clearCodes && monitor.shouldClear())
+      {
+         sink(CLEAR_CODE, dictSize - 1);
+         resetEncoderTables(tables, parameters);
+         matchNode = -1;
+      }
+
+      previousNode = matchNode;
+      position += matchLength;
+   }
+}
+
+// Encode size bytes starting at data with the dictionary in tables, handing every code and its bound to sink.
+template <typename CodeSink>
+void encode(const unsigned char *data, std::size_t size, CodeSink &sink, const LzwParameters &parameters, LzwEncoderTables &tables)
+{
+   if (parameters.growth == GROWTH_LZW && parameters.hashedEncoder)
+   {
+      encodeLzwHashed(data, size, sink, parameters, tables);
+   }
+   else if (parameters.growth == GROWTH_LZW)
+   {
+      encodeLzw(data, size, sink, parameters, tables);
+   }
+   else
+   {
+      encodeMultiPhrase(data, size, sink, parameters, tables);
+   }
+}
+
+// Encode size bytes starting at data, handing every code and its bound to sink.
+template <typename CodeSink>
+void encode(const unsigned char *data, std::size_t size, CodeSink &sink, const LzwParameters &parameters)
+{
+   LzwEncoderTables tables;
+   resetEncoderTables(tables, parameters);
+   encode(data, size, sink, parameters, tables);
+}
+
+// Compress size bytes starting at data to a list of output symbols.
+// The result will be written to the output iterator
+// starting at "result"; the final iterator is returned.
+// The dictionary grows until it holds 2^maxCodeWidth entries.
+// With useClearCode, code 256 is reserved as CLEAR and phrases start at 257. Once the dictionary is full
+// the ratio of input bytes per output code is watched over windows of CLEAR_CHECK_INTERVAL bytes, and
+// when a window falls well below the best window since the dictionary filled, CLEAR is emitted and the
+// dictionary is rebuilt so it can adapt to the new statistics of the input.
+template <typename Iterator>
+Iterator compress(const unsigned char *data, std::size_t size, Iterator result, int maxCodeWidth = 16, bool useClearCode = false)
+{
+   IteratorCodeSink<Iterator> sink(result);
+   encode(data, size, sink, LzwParameters(maxCodeWidth, useClearCode));
+   return sink.result;
+}
+
+// convenience overload for text held in a std::string
+template <typename Iterator>
+Iterator compress(const std::string &uncompressed, Iterator result, int maxCodeWidth = 16, bool useClearCode = false)
+{
+   return compress((const unsigned char *) uncompressed.data(), uncompressed.size(), result, maxCodeWidth, useClearCode);
+}
+
+/* DECODER */
+
+// classic LZW decoder. every new phrase is the previous phrase plus the first byte of the one after it,
+// and the two sit next to each other in the output. so instead of a prefix chain that has to be walked
+// backwards, each code is kept as (offset, length) into the result and written with one forward copy.
+// result must start with tables.history, the output the offsets of a preset point into.
+// the state between two codes is kept in a class so fixed-width readers can drive it code by code
+// (see decodePackedLzw in lzwContainer435M.hpp).
+// Output is a std::vector<unsigned char> or anything with the same size, resize, push_back and operator[]
+// (FixedOutput in lzwContainer435M.hpp), as for the decoders below.
+template <typename Output>
+class LzwDecoderState
+{
+public:
+   LzwDecoderState(const LzwParameters &parameters, LzwDecoderTables &tables, Output &result)
+      : parameters(parameters), dictionaryLimit(parameters.dictionaryLimit()), firstFreeCode(parameters.firstFreeCode()),
+        tables(tables), result(result), w(-1), previousStart(0) {}
+
+   // largest code the encoder can have sent next; it is one entry ahead of us, except right after a CLEAR
+   int bound() const
+   {
+      return w < 0 ? tables.dictSize - 1 : std::min(tables.dictSize, dictionaryLimit - 1);
+   }
+
+   // Decode code k onto the end of the result. Returns true if k was a CLEAR, after which bound() can shrink.
+   bool decodeCode(int k)
+   {
+      int &dictSize = tables.dictSize;
+      std::vector<std::size_t> &offset = tables.offset;
+      std::vector<std::size_t> &length = tables.length;
+
+      if (parameters.clearCodes && k == CLEAR_CODE)
+      {
+         // the encoder started over, so do we
+         resetDecoderTables(tables, parameters);
+         w = -1;
+         return true;
+      }
+
+      // if there's a representation in dictionary, output the translation.
+      // the first code of a stream (or after a CLEAR) is always already in the dictionary
+      std::size_t start = result.size();
+      if (k >= 0 && k <= 255)
+      {
+         result.push_back((unsigned char) k);
+      }
+      else if (k >= firstFreeCode && k < dictSize)
+      {
+         // the phrase lies entirely before start, so the copy never overlaps itself
+         result.resize(start + length[k]);
+         std::memcpy(&result[start], &result[offset[k]], length[k]);
+      }
+      else if (w >= 0 && k == dictSize && dictSize < dictionaryLimit)
+      {
+         // special case: k is the entry about to be added, previous word + first char of previous word
+         result.resize(start + length[w] + 1);
+         std::memcpy(&result[start], &result[previousStart], length[w]);
+         result[start + length[w]] = result[previousStart];
+      }
+      else
+      {
+         throw "Bad compressed k";
+      }
+
+      // Add w + first char of this entry to the dictionary while there is room for it
+      if (w >= 0 && dictSize < dictionaryLimit)
+      {
+         offset.push_back(previousStart);
+         length.push_back(length[w] + 1);
+         ++dictSize;
+      }
+
+      // this entry is the new "old" word for the next iteration
+      w = k;
+      previousStart = start;
+      return false;
+   }
+
+private:
+   const LzwParameters &parameters;
+   const int dictionaryLimit;
+   const int firstFreeCode;
+   LzwDecoderTables &tables;
+   Output &result;
+
+   int w;                     // code of the "old" word; -1 at the start and right after a CLEAR
+   std::size_t previousStart; // where w starts in result
+};
+
+template <typename CodeSource, typename Output>
+void decodeLzw(CodeSource &source, const LzwParameters &parameters, LzwDecoderTables &tables, Output &result)
+{
+   LzwDecoderState<Output> state(parameters, tables, result);
+
+   // store current code from compressed
+   int k;
+   while (source(state.bound(), k))
+   {
+      state.decodeCode(k);
+   }
+}
+
+// LZMW and LZAP decoder. every new phrase (prev + cur or prev + a prefix of cur) is a run of bytes
+// that was just written, so each code is kept as (offset, length) into the result and copied forward.
+// result must start with tables.history, the output the offsets of a preset point into.
+template <typename CodeSource, typename Output>
+void decodeMultiPhrase(CodeSource &source, const LzwParameters &parameters, LzwDecoderTables &tables, Output &result)
+{
+   const int dictionaryLimit = parameters.dictionaryLimit();
+   const int firstFreeCode = parameters.firstFreeCode();
+   int &dictSize = tables.dictSize;
+   std::vector<std::size_t> &offset = tables.offset;
+   std::vector<std::size_t> &length = tables.length;
+
+   // where the previous match starts in result, and its length; length 0 at the start and after a CLEAR
+   std::size_t previousStart = 0;
+   std::size_t previousLength = 0;
+
+   int k;
+   while (source(dictSize - 1, k))
+   {
+      if (parameters.clearCodes && k == CLEAR_CODE)
+      {
+         // the preset history is still at the front of result, so its offsets stay valid
+         resetDecoderTables(tables, parameters);
+         previousLength = 0;
+         continue;
+      }
+
+      std::size_t start = result.size();
+      if (k >= 0 && k <= 255)
+      {
+         result.push_back((unsigned char) k);
+      }
+      else if (k >= firstFreeCode && k < dictSize)
+      {
+         // the phrase lies entirely before start, so the copy never overlaps itself
+         result.resize(start + length[k]);
+         std::memcpy(&result[start], &result[offset[k]], length[k]);
+      }
+      else
+      {
+         throw "Bad compressed k";
+      }
+      std::size_t currentLength = result.size() - start;
+
+      if (previousLength > 0)
+      {
+         // the same entries the encoder added after this match
+         std::size_t firstLength = parameters.growth == GROWTH_LZAP ? 1 : currentLength;
+         for (std::size_t j = firstLength; j <= currentLength && dictSize < dictionaryLimit; ++j)
+         {
+            offset.push_back(previousStart);
+            length.push_back(previousLength + j);
+            ++dictSize;
+         }
+      }
+
+      previousStart = start;
+      previousLength = currentLength;
+   }
+}
+
+// Decode the codes handed out by source with the dictionary in tables, appending the bytes to result.
+template <typename CodeSource, typename Output>
+void decode(CodeSource &source, const LzwParameters &parameters, LzwDecoderTables &tables, Output &result)
+{
+   if (parameters.growth == GROWTH_LZW)
+   {
+      decodeLzw(source, parameters, tables, result);
+   }
+   else
+   {
+      decodeMultiPhrase(source, parameters, tables, result);
+   }
+}
+
+// Decode the codes handed out by source back to the original bytes.
+template <typename CodeSource>
+std::vector<unsigned char> decode(CodeSource &source, const LzwParameters &parameters)
+{
+   LzwDecoderTables tables;
+   resetDecoderTables(tables, parameters);
+
+   std::vector<unsigned char> result(tables.history);
+   decode(source, parameters, tables, result);
+
+   // drop the preset history the phrases of a preset dictionary were copied from
+   result.erase(result.begin(), result.begin() + tables.history.size());
+   return result;
+}
+
+/* PRESET DICTIONARIES */
+
+// Run primer through encoder and decoder (with parameters.preset ignored) and keep the tables they end up
+// with. Messages coded with the result as parameters.preset start from a dictionary that already holds the
+// phrases of the primer, which makes a large difference for short inputs.
+inline LzwPreset primeDictionary(const unsigned char *primer, std::size_t size, const LzwParameters &parameters)
+{
+   LzwParameters seed(parameters);
+   seed.preset = NULL;
+   seed.hashedEncoder = false; // the preset is kept as a trie
+
+   LzwPreset preset;
+   std::vector<int> codes;
+   IteratorCodeSink<std::back_insert_iterator<std::vector<int> > > sink(std::back_inserter(codes));
+   resetEncoderTables(preset.encoder, seed);
+   encode(primer, size, sink, seed, preset.encoder);
+
+   RangeCodeSource<std::vector<int>::const_iterator> source(codes.begin(), codes.end());
+   resetDecoderTables(preset.decoder, seed);
+   std::vector<unsigned char> history;
+   decode(source, seed, preset.decoder, history);
+   preset.decoder.history.swap(history);
+
+   return preset;
+}
+
+// Decompress a list of output ks to the original bytes.
+// "begin" and "end" must form a valid range of ints
+// maxCodeWidth and useClearCode must match the values the codes were compressed with.
+template <typename Iterator>
+std::vector<unsigned char> decompress(Iterator begin, Iterator end, int maxCodeWidth = 16, bool useClearCode = false)
+{
+   RangeCodeSource<Iterator> source(begin, end);
+   return decode(source, LzwParameters(maxCodeWidth, useClearCode));
+}
+
+#endif
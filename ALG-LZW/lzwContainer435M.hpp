@@ -0,0 +1,785 @@
+/*
+    lzwContainer435M.hpp
+
+    reading and writing of the .lzw2 container used by driver lzw435M.cpp for lzw compression Part 2
+
+    .lzw2 layout (all multi-byte integers are little-endian)
+
+        header  : "LZW2" | version (1 byte) | flags (1 byte) | max code width (1 byte) | growth policy (1 byte)
+                  | uncompressed size (8 bytes)
+                  [ dictionary id (4 bytes), FLAG_DICTIONARY only ]
+        blocks  : one or more independent LZW code streams. each block restarts the dictionary
+                  and the code width (9 bits, growing with the dictionary up to the max code width), and is
+                  padded with 0 bits to a byte boundary. the growth policy (0 LZW, 1 LZMW, 2 LZAP) selects
+                  which phrases are added to the dictionary.
+                  every block ends with the CRC32C of its uncompressed bytes (4 bytes, lzwChecksum435M.hpp),
+                  which the reader checks along with the block's size before handing any of it back.
+                  with FLAG_RANGE_CODED the codes of each block are range coded (lzwRangeCoder435M.hpp)
+                  instead of packed, and the code width of the index is unused.
+                  with FLAG_DICTIONARY every block starts from the preset dictionary named by the header
+                  (lzwDictionary435M.hpp) instead of the 256 single bytes, and returns to it after a CLEAR
+                  with FLAG_CLEAR_CODES, code 256 is CLEAR and resets the dictionary and code width mid-block
+        index   : (FLAG_INDEXED only) one entry per block
+                  { uncompressed offset (8 bytes) | compressed offset (8 bytes) | code width (1 byte) }
+        trailer : (FLAG_INDEXED only) index offset (8 bytes) | block count (4 bytes) | uncompressed size (8 bytes)
+
+    without the index the whole input is stored as a single block running from the header to the end of file.
+    with the index, any byte range of the original can be recovered by decoding only the blocks that overlap it.
+
+    version 1 streams have neither the uncompressed size in the header nor block checksums. they are still read,
+    but corruption in them can only be noticed where it breaks the code stream.
+*/
+
+#ifndef LZWCONTAINER435M_HPP
+#define LZWCONTAINER435M_HPP
+
+#include "lzwCodec435.hpp"
+#include "lzwRangeCoder435M.hpp"
+#include "lzwFileIO435.hpp"
+#include "lzwDictionary435M.hpp"
+#include "lzwChecksum435M.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+
+const char LZW2_MAGIC[4] = { 'L', 'Z', 'W', '2' };
+const unsigned char LZW2_VERSION = 2;
+const unsigned char LZW2_UNCHECKED_VERSION = 1; // no uncompressed size, no block checksums
+const unsigned char LZW2_FLAG_INDEXED = 0x01;
+const unsigned char LZW2_FLAG_CLEAR_CODES = 0x02;
+const unsigned char LZW2_FLAG_RANGE_CODED = 0x04;
+const unsigned char LZW2_FLAG_DICTIONARY = 0x08;
+
+const int LZW2_HEADER_SIZE = 8;
+const int LZW2_SIZE_FIELD_SIZE = 8;
+const int LZW2_CHECKSUM_SIZE = 4;
+const int LZW2_DICTIONARY_ID_SIZE = 4;
+const int LZW2_INDEX_ENTRY_SIZE = 17;
+const int LZW2_TRAILER_SIZE = 20;
+
+const int LZW2_DEFAULT_CODE_WIDTH = 16; // 65,536 dictionary entries = 2^16
+
+const std::size_t LZW2_DEFAULT_BLOCK_SIZE = 1 << 20; // 1 MiB of input per block in indexed mode
+const std::size_t LZW2_RESERVE_EXPANSION = 64;       // output reserved up front per compressed byte, at most
+
+// one entry of the block index: where a block starts in the original and in the .lzw2 file,
+// and the code width the decoder must be in when it starts reading that block
+struct Lzw2BlockEntry
+{
+   std::uint64_t uncompressedOffset;
+   std::uint64_t compressedOffset;
+   int codeWidth;
+};
+
+// how writeLzw2 lays out and encodes a stream. everything but blockSize is recorded in the header,
+// and readLzw2Header hands the same structure back to the reader, along with the version and size it found.
+// the codec parameters (max code width, CLEAR codes, growth policy) are inherited from LzwParameters.
+struct Lzw2Options : LzwParameters
+{
+   bool indexed;          // cut the input into blocks and append a block index
+   std::size_t blockSize; // bytes of input per block when indexed
+   bool rangeCoded;       // entropy code the codes with the adaptive range coder instead of packing them
+   bool presetDictionary; // every block starts from a preset dictionary
+   std::uint32_t dictionaryId;
+   int version;                   // set by readLzw2Header, writeLzw2 always writes LZW2_VERSION
+   std::uint64_t uncompressedSize; // set by readLzw2Header (version 2 and up), writeLzw2 takes the input size
+
+   Lzw2Options() : LzwParameters(LZW2_DEFAULT_CODE_WIDTH, true, GROWTH_LZW), indexed(false), blockSize(LZW2_DEFAULT_BLOCK_SIZE),
+                   rangeCoded(false), presetDictionary(false), dictionaryId(0), version(LZW2_VERSION), uncompressedSize(0) {}
+
+   bool checksummed() const { return version > LZW2_UNCHECKED_VERSION; }
+
+   // bytes before the first block
+   std::size_t headerSize() const
+   {
+      return LZW2_HEADER_SIZE + (checksummed() ? LZW2_SIZE_FIELD_SIZE : 0) + (presetDictionary ? LZW2_DICTIONARY_ID_SIZE : 0);
+   }
+
+   // bytes after the codes of every block
+   std::size_t blockTrailerSize() const { return checksummed() ? LZW2_CHECKSUM_SIZE : 0; }
+};
+
+// tables and buffers the readers and writers can keep between calls (see Lzw2Encoder and Lzw2Decoder in
+// lzwLibrary435M.hpp), so coding another stream reuses their memory instead of allocating it again
+struct Lzw2Workspace
+{
+   LzwEncoderTables encoder;
+   LzwDecoderTables decoder;
+   std::vector<unsigned char> block; // a block decoded behind the history of a preset dictionary
+};
+
+// Caller memory of a fixed capacity, filled by the encoder and decoders in place of a std::vector<unsigned char>.
+// Growing it past its capacity throws, so a result that does not fit is refused as soon as it is known.
+class FixedOutput
+{
+public:
+   FixedOutput(unsigned char *out, std::size_t capacity) : out(out), capacity(capacity), used(0) {}
+
+   std::size_t size() const { return used; }
+   unsigned char *data() { return out; }
+   unsigned char &operator[](std::size_t i) { return out[i]; }
+
+   void push_back(unsigned char byte)
+   {
+      if (used == capacity)
+      {
+         throw "lzw2 output buffer too small";
+      }
+      out[used++] = byte;
+   }
+
+   void resize(std::size_t size)
+   {
+      if (size > capacity)
+      {
+         throw "lzw2 output buffer too small";
+      }
+      used = size;
+   }
+
+   void reserve(std::size_t) {} // the capacity is fixed
+
+private:
+   unsigned char *out;
+   std::size_t capacity;
+   std::size_t used;
+};
+
+inline void appendBytes(std::vector<unsigned char> &out, const unsigned char *data, std::size_t size)
+{
+   out.insert(out.end(), data, data + size);
+}
+
+inline void appendBytes(FixedOutput &out, const unsigned char *data, std::size_t size)
+{
+   std::size_t start = out.size();
+   out.resize(start + size);
+   std::memcpy(out.data() + start, data, size);
+}
+
+struct Lzw2Index
+{
+   std::vector<Lzw2BlockEntry> blocks;
+   Lzw2Options options;            // as recorded in the header
+   std::uint64_t indexOffset;      // file offset one past the last compressed block
+   std::uint64_t uncompressedSize; // size of the original input
+};
+
+/* BYTE ORDER HELPERS */
+
+template <typename Output>
+void writeLittleEndian(Output &out, std::uint64_t value, int byteCount)
+{
+   for (int i = 0; i < byteCount; ++i)
+   {
+      out.push_back((unsigned char) ((value >> (8 * i)) & 255));
+   }
+}
+
+inline std::uint64_t readLittleEndian(const unsigned char *bytes, int byteCount)
+{
+   std::uint64_t value = 0;
+   for (int i = byteCount - 1; i >= 0; --i)
+   {
+      value = (value << 8) | bytes[i];
+   }
+   return value;
+}
+
+/* CODE PACKING */
+
+// Code sink packing codes MSB-first into out. Every code is written with just enough bits for its bound,
+// the largest code the decoder could see at that point, and never less than startWidth bits. The width
+// therefore grows by one bit each time the dictionary passes the next power of 2 and drops back to
+// startWidth after a CLEAR, however many entries the growth policy adds per code.
+// Output is a std::vector<unsigned char> or a FixedOutput, as for the decoders.
+template <typename Output>
+struct CodePacker
+{
+   Output &out;
+   int startWidth;
+   int width;               // width of the last code; the bound only crosses a power of 2 now and then
+   std::uint64_t bitBuffer; // holds the bits not yet flushed to out (low "pending" bits)
+   int pending;
+
+   CodePacker(Output &out, int startWidth)
+      : out(out), startWidth(startWidth), width(startWidth), bitBuffer(0), pending(0) {}
+
+   void operator()(int code, int bound)
+   {
+      if (bound >= (1 << width) || (width > startWidth && bound < (1 << (width - 1))))
+      {
+         width = codeWidthFor(bound, startWidth);
+      }
+      bitBuffer = (bitBuffer << width) | (std::uint64_t) code;
+      pending += width;
+      while (pending >= 8)
+      {
+         pending -= 8;
+         out.push_back((unsigned char) ((bitBuffer >> pending) & 255));
+      }
+   }
+
+   // pad the final partial byte with 0s
+   void flush()
+   {
+      if (pending > 0)
+      {
+         out.push_back((unsigned char) ((bitBuffer << (8 - pending)) & 255));
+         pending = 0;
+      }
+   }
+};
+
+// Code source undoing CodePacker. Trailing pad bits are never long enough to form a code, so they are dropped.
+struct CodeUnpacker
+{
+   const unsigned char *data;
+   const unsigned char *end;
+   int startWidth;
+   int width;
+   std::uint64_t bitBuffer; // low "available" bits are still to be read
+   int available;
+
+   CodeUnpacker(const unsigned char *data, std::size_t size, int startWidth)
+      : data(data), end(data + size), startWidth(startWidth), width(startWidth), bitBuffer(0), available(0) {}
+
+   bool operator()(int bound, int &code)
+   {
+      if (bound >= (1 << width) || (width > startWidth && bound < (1 << (width - 1))))
+      {
+         width = codeWidthFor(bound, startWidth);
+      }
+      if (available < width && !refill(width))
+      {
+         return false;
+      }
+      available -= width;
+      code = (int) ((bitBuffer >> available) & ((1UL << width) - 1));
+      return true;
+   }
+
+   // read a code known to be WIDTH bits wide; the shift and mask are constants
+   template <int WIDTH>
+   bool read(int &code)
+   {
+      if (available < WIDTH && !refill(WIDTH))
+      {
+         return false;
+      }
+      available -= WIDTH;
+      code = (int) ((bitBuffer >> available) & ((1UL << WIDTH) - 1));
+      return true;
+   }
+
+   // top bitBuffer up with whole bytes, as many as fit, so most codes are read without touching data.
+   // false if fewer than bits bits are left
+   bool refill(int bits)
+   {
+      while (available <= 56 && data != end)
+      {
+         bitBuffer = (bitBuffer << 8) | *data++;
+         available += 8;
+      }
+      return available >= bits;
+   }
+};
+
+/* FIXED WIDTH DECODING */
+
+// classic LZW codes only ever change width when the dictionary passes a power of 2 or is cleared, so the
+// packed codes fall into phases of one width each. every width from 9 to 24 bits gets its own copy of the
+// decoding loop below, compiled with the width as a constant, and the width is only looked at again when
+// a phase ends. the codes are the same ones decodeLzw would read; only the unpacking is cheaper.
+
+// Decode WIDTH bit codes until the bound needs a wider code or a CLEAR arrives. false at the end of data.
+template <int WIDTH, typename Output>
+bool decodeLzwPhase(CodeUnpacker &unpacker, LzwDecoderState<Output> &state)
+{
+   int k;
+   while (state.bound() < (1 << WIDTH))
+   {
+      if (!unpacker.read<WIDTH>(k))
+      {
+         return false;
+      }
+      if (state.decodeCode(k))
+      {
+         return true;
+      }
+   }
+   return true;
+}
+
+// pick the instance of decodeLzwPhase for width at run time, once per phase
+template <int WIDTH, typename Output>
+bool decodeLzwPhaseOfWidth(int width, CodeUnpacker &unpacker, LzwDecoderState<Output> &state)
+{
+   if (width == WIDTH)
+   {
+      return decodeLzwPhase<WIDTH>(unpacker, state);
+   }
+   if (WIDTH >= LZW_MAX_CODE_WIDTH)
+   {
+      throw "Unsupported lzw2 code width";
+   }
+   // the recursion stops at the widest code (the call is never made there)
+   return decodeLzwPhaseOfWidth<(WIDTH < LZW_MAX_CODE_WIDTH ? WIDTH + 1 : WIDTH)>(width, unpacker, state);
+}
+
+// classic LZW decoding of packed codes whose first code is startWidth bits wide, phase by phase
+template <typename Output>
+void decodePackedLzw(const unsigned char *data, std::size_t size, int startWidth, const LzwParameters &parameters,
+                     LzwDecoderTables &tables, Output &result)
+{
+   CodeUnpacker unpacker(data, size, startWidth);
+   LzwDecoderState<Output> state(parameters, tables, result);
+   while (decodeLzwPhaseOfWidth<LZW_MIN_CODE_WIDTH>(codeWidthFor(state.bound(), startWidth), unpacker, state))
+   {
+   }
+}
+
+/* BLOCKS */
+
+// compress one independent block of input with tables and append its packed codes and checksum to out
+template <typename Output>
+void compressBlock(const unsigned char *block, std::size_t size, const Lzw2Options &options, Output &out, LzwEncoderTables &tables)
+{
+   resetEncoderTables(tables, options);
+   if (options.rangeCoded)
+   {
+      RangeCodeEncoder<Output> encoder(out);
+      encode(block, size, encoder, options, tables);
+      encoder.flush();
+   }
+   else
+   {
+      CodePacker<Output> packer(out, LZW_MIN_CODE_WIDTH);
+      encode(block, size, packer, options, tables);
+      packer.flush();
+   }
+
+   writeLittleEndian(out, crc32c(block, size), LZW2_CHECKSUM_SIZE);
+}
+
+template <typename Output>
+void decodeBlockCodes(const unsigned char *data, std::size_t size, int codeWidth, const Lzw2Options &options, LzwDecoderTables &tables,
+                      Output &result)
+{
+   if (options.rangeCoded)
+   {
+      RangeCodeDecoder decoder(data, size);
+      decode(decoder, options, tables, result);
+      return;
+   }
+
+   if (options.growth == GROWTH_LZW)
+   {
+      decodePackedLzw(data, size, codeWidth, options, tables, result);
+      return;
+   }
+
+   CodeUnpacker unpacker(data, size, codeWidth);
+   decode(unpacker, options, tables, result);
+}
+
+// check a decoded block against the size and checksum recorded for it, when the stream has them
+inline void checkDecodedBlock(const unsigned char *decoded, std::size_t size, std::uint64_t expectedSize, const unsigned char *checksum,
+                              const Lzw2Options &options)
+{
+   if (options.checksummed())
+   {
+      if (size != expectedSize)
+      {
+         throw "Corrupt lzw2 block (wrong size)";
+      }
+      if (crc32c(decoded, size) != readLittleEndian(checksum, LZW2_CHECKSUM_SIZE))
+      {
+         throw "Corrupt lzw2 block (checksum mismatch)";
+      }
+   }
+}
+
+// Decode one block whose first code is codeWidth bits wide and which should expand to expectedSize bytes,
+// appending it to out (a std::vector<unsigned char> or a FixedOutput). The size and the checksum are checked
+// when the stream has them (expectedSize is ignored in version 1). What was appended to out is unspecified
+// when this throws.
+template <typename Output>
+void decompressBlock(const unsigned char *data, std::size_t size, int codeWidth, std::uint64_t expectedSize,
+                     const Lzw2Options &options, Lzw2Workspace &workspace, Output &out)
+{
+   if (codeWidth < LZW_MIN_CODE_WIDTH || codeWidth > options.maxCodeWidth)
+   {
+      throw "Bad lzw2 code width";
+   }
+   if (size < options.blockTrailerSize())
+   {
+      throw "Truncated lzw2 block";
+   }
+
+   LzwDecoderTables &tables = workspace.decoder;
+   resetDecoderTables(tables, options);
+   std::size_t codeBytes = size - options.blockTrailerSize();
+
+   // the decoder copies phrases from where they sit in its result, so a block can be decoded straight onto
+   // the end of out, unless the phrases of a preset dictionary point into a history that has to come first
+   if (tables.history.empty())
+   {
+      std::size_t start = out.size();
+      decodeBlockCodes(data, codeBytes, codeWidth, options, tables, out);
+      checkDecodedBlock(out.data() + start, out.size() - start, expectedSize, data + codeBytes, options);
+      return;
+   }
+
+   std::vector<unsigned char> &block = workspace.block;
+   block.assign(tables.history.begin(), tables.history.end());
+   std::size_t start = block.size();
+   decodeBlockCodes(data, codeBytes, codeWidth, options, tables, block);
+   checkDecodedBlock(block.data() + start, block.size() - start, expectedSize, data + codeBytes, options);
+   appendBytes(out, block.data() + start, block.size() - start);
+}
+
+/* WRITING */
+
+// Append input as a .lzw2 stream to out. When options.indexed is set the input is cut into blocks of
+// options.blockSize bytes and a block index is appended so decompressRange can seek straight to the blocks it needs.
+// With a dictionary every block starts from its primed tables, and its id is recorded in the header.
+// The dictionary tables are kept in workspace. out is a std::vector<unsigned char> or a FixedOutput, which throws
+// as soon as the stream outgrows it.
+template <typename Output>
+void writeLzw2(Output &out, const unsigned char *input, std::size_t size, const Lzw2Options &requested,
+               const Lzw2Dictionary *dictionary, Lzw2Workspace &workspace)
+{
+   Lzw2Options options(requested);
+   options.presetDictionary = dictionary != NULL;
+   options.dictionaryId = dictionary != NULL ? dictionary->getId() : 0;
+   options.preset = NULL;
+   options.version = LZW2_VERSION;
+   options.uncompressedSize = size;
+
+   if (!isValidCodeWidth(options.maxCodeWidth))
+   {
+      throw "Unsupported lzw2 code width";
+   }
+   if (!isValidGrowthPolicy(options.growth))
+   {
+      throw "Unsupported lzw2 growth policy";
+   }
+
+   if (dictionary != NULL)
+   {
+      options.preset = &dictionary->presetFor(options);
+   }
+
+   unsigned char flags = (options.indexed ? LZW2_FLAG_INDEXED : 0) | (options.clearCodes ? LZW2_FLAG_CLEAR_CODES : 0)
+                        | (options.rangeCoded ? LZW2_FLAG_RANGE_CODED : 0) | (options.presetDictionary ? LZW2_FLAG_DICTIONARY : 0);
+
+   std::size_t streamStart = out.size();
+   for (int i = 0; i < 4; ++i)
+   {
+      out.push_back((unsigned char) LZW2_MAGIC[i]);
+   }
+   writeLittleEndian(out, LZW2_VERSION, 1);
+   writeLittleEndian(out, flags, 1);
+   writeLittleEndian(out, options.maxCodeWidth, 1);
+   writeLittleEndian(out, options.growth, 1);
+   writeLittleEndian(out, options.uncompressedSize, LZW2_SIZE_FIELD_SIZE);
+   if (options.presetDictionary)
+   {
+      writeLittleEndian(out, options.dictionaryId, LZW2_DICTIONARY_ID_SIZE);
+   }
+
+   if (!options.indexed)
+   {
+      compressBlock(input, size, options, out, workspace.encoder);
+      return;
+   }
+
+   std::vector<Lzw2BlockEntry> blocks;
+   for (std::size_t start = 0; start < size; start += options.blockSize)
+   {
+      Lzw2BlockEntry entry;
+      entry.uncompressedOffset = start;
+      entry.compressedOffset = out.size() - streamStart;
+      entry.codeWidth = LZW_MIN_CODE_WIDTH;
+      blocks.push_back(entry);
+
+      compressBlock(input + start, std::min(options.blockSize, size - start), options, out, workspace.encoder);
+   }
+   std::uint64_t indexOffset = out.size() - streamStart;
+
+   for (std::vector<Lzw2BlockEntry>::const_iterator itr = blocks.begin(); itr != blocks.end(); ++itr)
+   {
+      writeLittleEndian(out, itr->uncompressedOffset, 8);
+      writeLittleEndian(out, itr->compressedOffset, 8);
+      writeLittleEndian(out, itr->codeWidth, 1);
+   }
+
+   writeLittleEndian(out, indexOffset, 8);
+   writeLittleEndian(out, blocks.size(), 4);
+   writeLittleEndian(out, size, 8);
+}
+
+inline void writeLzw2(std::vector<unsigned char> &out, const unsigned char *input, std::size_t size, const Lzw2Options &requested = Lzw2Options(),
+                      const Lzw2Dictionary *dictionary = NULL)
+{
+   Lzw2Workspace workspace;
+   writeLzw2(out, input, size, requested, dictionary, workspace);
+}
+
+/* READING */
+
+// the readers work on the whole stream in memory (usually a mapped file, see lzwFileIO435.hpp)
+// and only touch the bytes they need
+
+// Whether a stream of size bytes can expand to uncompressedSize bytes, checked before a size field read from the
+// stream is trusted. Without range coding every code takes at least LZW_MIN_CODE_WIDTH bits, and with lzw growth
+// the phrase of the t-th code is at most t + 1 bytes longer than the longest preset phrase (the primer), so n codes
+// expand to at most n * (n + 1) / 2 + n * primer bytes. Range coding and the other policies have no such bound.
+inline bool isPlausibleUncompressedSize(const Lzw2Options &options, std::size_t size, const Lzw2Dictionary *dictionary,
+                                        std::uint64_t uncompressedSize)
+{
+   if (options.rangeCoded || options.growth != GROWTH_LZW)
+   {
+      return true;
+   }
+
+   std::uint64_t codes = (std::uint64_t) size * 8 / LZW_MIN_CODE_WIDTH;
+   if (codes >= (1ull << 31))
+   {
+      return true; // the bound no longer fits in 64 bits
+   }
+   std::uint64_t primer = (options.presetDictionary && dictionary != NULL) ? dictionary->getPrimer().size() : 0;
+   return uncompressedSize <= codes * (codes + 1) / 2 + codes * primer;
+}
+
+// Validate the header, returning the options the stream was written with. A stream compressed with a
+// preset dictionary can only be read with that dictionary.
+inline Lzw2Options readLzw2Header(const unsigned char *data, std::size_t size, const Lzw2Dictionary *dictionary = NULL)
+{
+   if (size < (std::size_t) LZW2_HEADER_SIZE || !std::equal(LZW2_MAGIC, LZW2_MAGIC + 4, (const char *) data))
+   {
+      throw "Bad lzw2 header";
+   }
+   if (data[4] != LZW2_VERSION && data[4] != LZW2_UNCHECKED_VERSION)
+   {
+      throw "Unsupported lzw2 version";
+   }
+
+   Lzw2Options options;
+   options.version = data[4];
+   options.indexed = (data[5] & LZW2_FLAG_INDEXED) != 0;
+   options.clearCodes = (data[5] & LZW2_FLAG_CLEAR_CODES) != 0;
+   options.rangeCoded = (data[5] & LZW2_FLAG_RANGE_CODED) != 0;
+
+   // streams written before the max code width was recorded leave this byte 0 and use 16 bits
+   options.maxCodeWidth = data[6] ? data[6] : LZW2_DEFAULT_CODE_WIDTH;
+   if (!isValidCodeWidth(options.maxCodeWidth))
+   {
+      throw "Unsupported lzw2 code width";
+   }
+
+   // 0 (plain LZW) in streams written before the growth policy was selectable
+   if (!isValidGrowthPolicy(data[7]))
+   {
+      throw "Unsupported lzw2 growth policy";
+   }
+   options.growth = (GrowthPolicy) data[7];
+
+   options.presetDictionary = (data[5] & LZW2_FLAG_DICTIONARY) != 0;
+   if (size < options.headerSize() + options.blockTrailerSize())
+   {
+      throw "Bad lzw2 header";
+   }
+   if (options.checksummed())
+   {
+      options.uncompressedSize = readLittleEndian(data + LZW2_HEADER_SIZE, LZW2_SIZE_FIELD_SIZE);
+   }
+
+   if (options.presetDictionary)
+   {
+      options.dictionaryId = readLittleEndian(data + options.headerSize() - LZW2_DICTIONARY_ID_SIZE, LZW2_DICTIONARY_ID_SIZE);
+      if (dictionary == NULL)
+      {
+         throw "lzw2 stream needs its preset dictionary";
+      }
+      if (dictionary->getId() != options.dictionaryId)
+      {
+         throw "Wrong preset dictionary for lzw2 stream";
+      }
+      options.preset = &dictionary->presetFor(options);
+   }
+
+   if (options.checksummed() && !isPlausibleUncompressedSize(options, size, dictionary, options.uncompressedSize))
+   {
+      throw "Bad lzw2 header (size out of range)";
+   }
+
+   return options;
+}
+
+// Load the block index of an indexed .lzw2 stream from its trailer.
+inline Lzw2Index readLzw2Index(const unsigned char *data, std::size_t size, const Lzw2Dictionary *dictionary = NULL)
+{
+   Lzw2Options options = readLzw2Header(data, size, dictionary);
+   if (!options.indexed)
+   {
+      throw "lzw2 stream has no block index";
+   }
+
+   if (size < options.headerSize() + LZW2_TRAILER_SIZE)
+   {
+      throw "Bad lzw2 trailer";
+   }
+   const unsigned char *trailer = data + size - LZW2_TRAILER_SIZE;
+
+   Lzw2Index index;
+   index.options = options;
+   index.indexOffset = readLittleEndian(trailer, 8);
+   std::uint64_t blockCount = readLittleEndian(trailer + 8, 4);
+   index.uncompressedSize = readLittleEndian(trailer + 12, 8);
+
+   if (index.indexOffset < options.headerSize() || index.indexOffset > size
+       || index.indexOffset + blockCount * LZW2_INDEX_ENTRY_SIZE + LZW2_TRAILER_SIZE != size
+       || (options.checksummed() && index.uncompressedSize != options.uncompressedSize)
+       || !isPlausibleUncompressedSize(options, size, dictionary, index.uncompressedSize))
+   {
+      throw "Bad lzw2 trailer";
+   }
+
+   for (std::uint64_t i = 0; i < blockCount; ++i)
+   {
+      const unsigned char *raw = data + index.indexOffset + i * LZW2_INDEX_ENTRY_SIZE;
+      Lzw2BlockEntry entry;
+      entry.uncompressedOffset = readLittleEndian(raw, 8);
+      entry.compressedOffset = readLittleEndian(raw + 8, 8);
+      entry.codeWidth = raw[16];
+
+      // blocks cover the original from 0 in order, each holding at least one byte
+      bool inOrder = index.blocks.empty() ? entry.uncompressedOffset == 0 : entry.uncompressedOffset > index.blocks.back().uncompressedOffset;
+      if (!inOrder || entry.uncompressedOffset >= index.uncompressedSize)
+      {
+         throw "Bad lzw2 block index";
+      }
+      index.blocks.push_back(entry);
+   }
+
+   return index;
+}
+
+// decode block i of an indexed stream, appending it to out
+template <typename Output>
+void readIndexedBlock(const unsigned char *data, const Lzw2Index &index, std::size_t i, Lzw2Workspace &workspace, Output &out)
+{
+   std::uint64_t begin = index.blocks[i].compressedOffset;
+   std::uint64_t end = (i + 1 < index.blocks.size()) ? index.blocks[i + 1].compressedOffset : index.indexOffset;
+   if (begin < index.options.headerSize() || end < begin || end > index.indexOffset)
+   {
+      throw "Bad lzw2 block offset";
+   }
+
+   std::uint64_t uncompressedEnd = (i + 1 < index.blocks.size()) ? index.blocks[i + 1].uncompressedOffset : index.uncompressedSize;
+   decompressBlock(data + begin, end - begin, index.blocks[i].codeWidth, uncompressedEnd - index.blocks[i].uncompressedOffset,
+                   index.options, workspace, out);
+}
+
+// Decompress an entire .lzw2 stream, indexed or not, appending it to out (a std::vector<unsigned char>, or
+// a FixedOutput to decode into memory of a fixed size).
+template <typename Output>
+void readLzw2(const unsigned char *data, std::size_t size, const Lzw2Dictionary *dictionary, Lzw2Workspace &workspace, Output &out)
+{
+   Lzw2Options options = readLzw2Header(data, size, dictionary);
+
+   if (options.indexed)
+   {
+      Lzw2Index index = readLzw2Index(data, size, dictionary);
+      // the recorded size is only checked against the blocks as they are decoded, so it is a hint here
+      out.reserve(out.size() + std::min<std::uint64_t>(index.uncompressedSize, (std::uint64_t) size * LZW2_RESERVE_EXPANSION));
+      std::size_t start = out.size();
+      for (std::size_t i = 0; i < index.blocks.size(); ++i)
+      {
+         readIndexedBlock(data, index, i, workspace, out);
+      }
+
+      // each block was checked against its own size, but an index without blocks checks nothing
+      if (out.size() - start != index.uncompressedSize)
+      {
+         throw "Corrupt lzw2 stream (wrong size)";
+      }
+      return;
+   }
+
+   if (options.checksummed())
+   {
+      out.reserve(out.size() + std::min<std::uint64_t>(options.uncompressedSize, (std::uint64_t) size * LZW2_RESERVE_EXPANSION));
+   }
+   decompressBlock(data + options.headerSize(), size - options.headerSize(), LZW_MIN_CODE_WIDTH, options.uncompressedSize, options, workspace, out);
+}
+
+inline std::vector<unsigned char> readLzw2(const unsigned char *data, std::size_t size, const Lzw2Dictionary *dictionary = NULL)
+{
+   Lzw2Workspace workspace;
+   std::vector<unsigned char> result;
+   readLzw2(data, size, dictionary, workspace, result);
+   return result;
+}
+
+// Recover bytes [offset, offset + length) of the original input. Indexed streams only decode the
+// blocks overlapping the range; streams without an index fall back to decoding everything.
+// The range is clipped to the end of the original input.
+inline std::vector<unsigned char> decompressRange(const unsigned char *data, std::size_t size, std::uint64_t offset, std::uint64_t length,
+                                                  const Lzw2Dictionary *dictionary = NULL)
+{
+   if (!readLzw2Header(data, size, dictionary).indexed)
+   {
+      std::vector<unsigned char> whole = readLzw2(data, size, dictionary);
+      if (offset >= whole.size())
+      {
+         return std::vector<unsigned char>();
+      }
+      return std::vector<unsigned char>(whole.begin() + offset, whole.begin() + std::min<std::uint64_t>(whole.size(), offset + std::min<std::uint64_t>(length, whole.size())));
+   }
+
+   Lzw2Index index = readLzw2Index(data, size, dictionary);
+   if (offset >= index.uncompressedSize || length == 0)
+   {
+      return std::vector<unsigned char>();
+   }
+   std::uint64_t end = std::min(index.uncompressedSize, offset + std::min(length, index.uncompressedSize));
+
+   // the first block that starts after offset; the block before it holds offset
+   std::vector<Lzw2BlockEntry>::const_iterator first = std::upper_bound(index.blocks.begin(), index.blocks.end(), offset,
+      [](std::uint64_t value, const Lzw2BlockEntry &entry) { return value < entry.uncompressedOffset; });
+
+   Lzw2Workspace workspace;
+   std::vector<unsigned char> block;
+   std::vector<unsigned char> result;
+   for (std::size_t i = std::distance(index.blocks.cbegin(), first) - 1; i < index.blocks.size() && index.blocks[i].uncompressedOffset < end; ++i)
+   {
+      block.clear();
+      readIndexedBlock(data, index, i, workspace, block);
+      std::uint64_t blockStart = index.blocks[i].uncompressedOffset;
+      std::uint64_t from = std::max(offset, blockStart) - blockStart;
+      std::uint64_t to = std::min<std::uint64_t>(end - blockStart, block.size());
+      if (from < to)
+      {
+         result.insert(result.end(), block.begin() + from, block.begin() + to);
+      }
+   }
+
+   return result;
+}
+
+inline std::vector<unsigned char> decompressRange(const std::string &filename, std::uint64_t offset, std::uint64_t length,
+                                                  const Lzw2Dictionary *dictionary = NULL)
+{
+   // only the pages holding the header, the index and the blocks overlapping the range are ever read
+   MappedFile file;
+   if (!file.open(filename))
+   {
+      throw "Unable to open lzw2 file";
+   }
+   return decompressRange(file.data(), file.size(), offset, length, dictionary);
+}
+
+#endif
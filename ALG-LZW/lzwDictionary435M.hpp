@@ -0,0 +1,250 @@
+/*
+    lzwDictionary435M.hpp
+
+    preset dictionaries for lzw compression Part 2
+
+    small inputs compress poorly with LZW because every one of them starts from the 256 single bytes and
+    ends before the dictionary has learned much. a preset dictionary is a primer, sample content typical of
+    the inputs, that both compressor and decompressor run through the codec before the real input (see
+    primeDictionary in lzwCodec435.hpp). the input then starts with the phrases of the primer already known.
+
+    trainDictionary picks the primer from a set of sample files: it cuts the samples into overlapping segments
+    and greedily keeps the segments whose DICTIONARY_GRAM byte substrings occur in the most samples. a substring
+    counts half as much each time the primer takes it in again: LZW learns a phrase one byte per occurrence,
+    so common content is worth repeating, but not at the expense of everything else.
+
+    .lzwd layout (all multi-byte integers are little-endian)
+
+        "LZWD" | version (1 byte) | dictionary id (4 bytes) | primer size (4 bytes) | primer
+
+    the id is a hash of the primer. streams compressed with a dictionary record its id in their header,
+    so they are never decoded with the wrong one.
+
+    yes, I know I'm not supposed to put code in a header file
+*/
+
+#ifndef LZWDICTIONARY435M_HPP
+#define LZWDICTIONARY435M_HPP
+
+#include "lzwCodec435.hpp"
+#include <cstdint>
+#include <queue>
+
+const char LZWD_MAGIC[4] = { 'L', 'Z', 'W', 'D' };
+const unsigned char LZWD_VERSION = 1;
+const int LZWD_HEADER_SIZE = 13;
+
+const std::size_t DICTIONARY_DEFAULT_SIZE = 32 * 1024; // bytes of primer trainDictionary aims for
+const std::size_t DICTIONARY_SEGMENT_SIZE = 256;       // primer is assembled from sample segments this long
+const std::size_t DICTIONARY_SEGMENT_STEP = 32;        // candidate segments start every 32 bytes
+const std::size_t DICTIONARY_GRAM = 6;                 // substrings scored while training
+const int DICTIONARY_GRAM_TABLE_BITS = 20;             // substrings are counted in a hash table of 2^20 slots
+
+class Lzw2Dictionary
+{
+public:
+   Lzw2Dictionary() : id(0), primed(false) {}
+
+   explicit Lzw2Dictionary(const std::vector<unsigned char> &primer) : id(hashPrimer(primer)), primer(primer), primed(false) {}
+
+   std::uint32_t getId() const { return id; }
+   const std::vector<unsigned char> &getPrimer() const { return primer; }
+
+   // The primed tables for parameters. Priming costs about as much as compressing the primer, so the
+   // tables are built on first use and reused for every later input coded with the same parameters.
+   // The first call for other parameters writes the cache without a lock, so threads may only share a
+   // dictionary once it has been primed for the parameters they use (see extractArchive).
+   const LzwPreset &presetFor(const LzwParameters &parameters) const
+   {
+      if (!primed || primedFor.maxCodeWidth != parameters.maxCodeWidth || primedFor.clearCodes != parameters.clearCodes
+          || primedFor.growth != parameters.growth)
+      {
+         preset = primeDictionary(primer.data(), primer.size(), parameters);
+         primedFor = parameters;
+         primed = true;
+      }
+      return preset;
+   }
+
+   // FNV-1a over the primer
+   static std::uint32_t hashPrimer(const std::vector<unsigned char> &primer)
+   {
+      std::uint32_t hash = 2166136261u;
+      for (std::size_t i = 0; i < primer.size(); ++i)
+      {
+         hash = (hash ^ primer[i]) * 16777619u;
+      }
+      return hash;
+   }
+
+private:
+   std::uint32_t id;
+   std::vector<unsigned char> primer;
+
+   mutable bool primed;
+   mutable LzwParameters primedFor;
+   mutable LzwPreset preset;
+};
+
+/* TRAINING */
+
+inline std::uint32_t gramSlot(const unsigned char *gram)
+{
+   std::uint32_t hash = 2166136261u;
+   for (std::size_t i = 0; i < DICTIONARY_GRAM; ++i)
+   {
+      hash = (hash ^ gram[i]) * 16777619u;
+   }
+   return hash >> (32 - DICTIONARY_GRAM_TABLE_BITS);
+}
+
+// a segment is worth the substrings it shares with other samples, each halved for every time the primer already holds it
+inline std::size_t segmentScore(const unsigned char *segment, std::size_t size, const std::vector<std::uint32_t> &frequency, const std::vector<unsigned char> &covered)
+{
+   std::size_t total = 0;
+   for (std::size_t i = 0; i + DICTIONARY_GRAM <= size; ++i)
+   {
+      std::uint32_t slot = gramSlot(segment + i);
+      if (frequency[slot] > 1)
+      {
+         total += frequency[slot] >> covered[slot];
+      }
+   }
+   return total;
+}
+
+struct DictionarySegment
+{
+   std::size_t score;
+   std::size_t sample;
+   std::size_t offset;
+
+   bool operator<(const DictionarySegment &other) const { return score < other.score; }
+};
+
+// Build a dictionary of about capacity bytes from samples (inputs typical of what will be compressed).
+inline Lzw2Dictionary trainDictionary(const std::vector<std::vector<unsigned char> > &samples, std::size_t capacity = DICTIONARY_DEFAULT_SIZE)
+{
+   // in how many samples each substring occurs; lastSample keeps one sample from counting twice.
+   // a single sample is scored by how often each substring occurs in it instead
+   bool singleSample = samples.size() == 1;
+   std::vector<std::uint32_t> frequency(1 << DICTIONARY_GRAM_TABLE_BITS, 0);
+   std::vector<std::uint32_t> lastSample(1 << DICTIONARY_GRAM_TABLE_BITS, 0);
+   for (std::size_t s = 0; s < samples.size(); ++s)
+   {
+      for (std::size_t i = 0; i + DICTIONARY_GRAM <= samples[s].size(); ++i)
+      {
+         std::uint32_t slot = gramSlot(&samples[s][i]);
+         if (singleSample || lastSample[slot] != s + 1)
+         {
+            lastSample[slot] = s + 1;
+            ++frequency[slot];
+         }
+      }
+   }
+
+   // how many times each substring is already in the primer
+   std::vector<unsigned char> covered(1 << DICTIONARY_GRAM_TABLE_BITS, 0);
+   std::priority_queue<DictionarySegment> candidates;
+   for (std::size_t s = 0; s < samples.size(); ++s)
+   {
+      for (std::size_t offset = 0; offset < samples[s].size(); offset += DICTIONARY_SEGMENT_STEP)
+      {
+         std::size_t size = std::min(DICTIONARY_SEGMENT_SIZE, samples[s].size() - offset);
+         DictionarySegment segment = { segmentScore(&samples[s][offset], size, frequency, covered), s, offset };
+         if (segment.score > 0)
+         {
+            candidates.push(segment);
+         }
+      }
+   }
+
+   // lazy greedy: a segment's score only drops as the primer grows, so a rescored segment that still
+   // beats the next best candidate is the best segment left
+   std::vector<unsigned char> primer;
+   while (!candidates.empty() && primer.size() < capacity)
+   {
+      DictionarySegment best = candidates.top();
+      candidates.pop();
+
+      const unsigned char *segment = &samples[best.sample][best.offset];
+      std::size_t size = std::min(DICTIONARY_SEGMENT_SIZE, samples[best.sample].size() - best.offset);
+      best.score = segmentScore(segment, size, frequency, covered);
+      if (best.score == 0)
+      {
+         continue;
+      }
+      if (!candidates.empty() && best.score < candidates.top().score)
+      {
+         candidates.push(best);
+         continue;
+      }
+
+      primer.insert(primer.end(), segment, segment + size);
+      for (std::size_t i = 0; i + DICTIONARY_GRAM <= size; ++i)
+      {
+         unsigned char &count = covered[gramSlot(segment + i)];
+         count = std::min(count + 1, 31);
+      }
+   }
+   if (primer.size() > capacity)
+   {
+      primer.resize(capacity);
+   }
+
+   return Lzw2Dictionary(primer);
+}
+
+/* SERIALIZATION */
+
+inline void writeDictionary(std::vector<unsigned char> &out, const Lzw2Dictionary &dictionary)
+{
+   const std::vector<unsigned char> &primer = dictionary.getPrimer();
+   for (int i = 0; i < 4; ++i)
+   {
+      out.push_back((unsigned char) LZWD_MAGIC[i]);
+   }
+   out.push_back(LZWD_VERSION);
+   for (int i = 0; i < 4; ++i)
+   {
+      out.push_back((unsigned char) ((dictionary.getId() >> (8 * i)) & 255));
+   }
+   for (int i = 0; i < 4; ++i)
+   {
+      out.push_back((unsigned char) ((primer.size() >> (8 * i)) & 255));
+   }
+   out.insert(out.end(), primer.begin(), primer.end());
+}
+
+inline Lzw2Dictionary readDictionary(const unsigned char *data, std::size_t size)
+{
+   if (size < (std::size_t) LZWD_HEADER_SIZE || !std::equal(LZWD_MAGIC, LZWD_MAGIC + 4, (const char *) data))
+   {
+      throw "Bad lzw2 dictionary";
+   }
+   if (data[4] != LZWD_VERSION)
+   {
+      throw "Unsupported lzw2 dictionary version";
+   }
+
+   std::uint32_t id = 0;
+   std::uint32_t primerSize = 0;
+   for (int i = 3; i >= 0; --i)
+   {
+      id = (id << 8) | data[5 + i];
+      primerSize = (primerSize << 8) | data[9 + i];
+   }
+   if (primerSize != size - LZWD_HEADER_SIZE)
+   {
+      throw "Bad lzw2 dictionary";
+   }
+
+   Lzw2Dictionary dictionary(std::vector<unsigned char>(data + LZWD_HEADER_SIZE, data + size));
+   if (dictionary.getId() != id)
+   {
+      throw "Corrupt lzw2 dictionary";
+   }
+   return dictionary;
+}
+
+#endif
@@ -0,0 +1,224 @@
+/*
+    lzwFileIO435.hpp
+
+    file input and output for drivers lzw435.cpp (Part 1) and lzw435M.cpp (Part 2)
+
+    input files are mapped into memory and handed to the codec as they are, so no copy of the input is ever made.
+    results are built in memory and written out with as few write() calls as the kernel allows.
+    archives (lzwArchive435M.hpp) also need to walk directory trees and create them again on extraction.
+
+    yes, I know I'm not supposed to put code in a header file
+*/
+
+#ifndef LZWFILEIO435_HPP
+#define LZWFILEIO435_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A read-only view of a whole file. Empty files are not mapped (mmap refuses them); data() is then NULL.
+class MappedFile
+{
+public:
+   MappedFile() : mapping(NULL), length(0) {}
+   ~MappedFile() { close(); }
+
+   // map filename, returning false if it cannot be opened or mapped
+   bool open(const std::string &filename)
+   {
+      close();
+
+      int fd = ::open(filename.c_str(), O_RDONLY);
+      if (fd < 0)
+      {
+         return false;
+      }
+
+      struct stat filestatus;
+      if (fstat(fd, &filestatus) != 0 || !S_ISREG(filestatus.st_mode))
+      {
+         ::close(fd);
+         return false;
+      }
+
+      length = filestatus.st_size;
+      if (length > 0)
+      {
+         void *address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+         if (address == MAP_FAILED)
+         {
+            ::close(fd);
+            length = 0;
+            return false;
+         }
+         mapping = (const unsigned char *) address;
+
+         // the codec reads front to back, let the kernel read ahead aggressively
+         madvise(address, length, MADV_SEQUENTIAL);
+      }
+
+      // the mapping stays valid after the descriptor is closed
+      ::close(fd);
+      return true;
+   }
+
+   void close()
+   {
+      if (mapping != NULL)
+      {
+         munmap((void *) mapping, length);
+      }
+      mapping = NULL;
+      length = 0;
+   }
+
+   const unsigned char *data() const { return mapping; }
+   std::size_t size() const { return length; }
+
+private:
+   MappedFile(const MappedFile &);
+   MappedFile &operator=(const MappedFile &);
+
+   const unsigned char *mapping;
+   std::size_t length;
+};
+
+// A file written front to back, each piece handed to write() whole.
+class OutputFile
+{
+public:
+   OutputFile() : fd(-1) {}
+   ~OutputFile() { close(); }
+
+   // create or truncate filename, returning false if it cannot be opened
+   bool open(const std::string &filename)
+   {
+      close();
+      fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      return fd >= 0;
+   }
+
+   // append size bytes starting at data, returning false if a write fails
+   bool write(const unsigned char *data, std::size_t size)
+   {
+      while (size > 0)
+      {
+         // write() may stop short (signals, pipes, huge requests), carry on from where it stopped
+         ssize_t written = ::write(fd, data, size);
+         if (written < 0)
+         {
+            if (errno == EINTR)
+            {
+               continue;
+            }
+            return false;
+         }
+         data += written;
+         size -= written;
+      }
+      return true;
+   }
+
+   // returns false if the data could not be written out after all
+   bool close()
+   {
+      if (fd < 0)
+      {
+         return true;
+      }
+      int result = ::close(fd);
+      fd = -1;
+      return result == 0;
+   }
+
+private:
+   OutputFile(const OutputFile &);
+   OutputFile &operator=(const OutputFile &);
+
+   int fd;
+};
+
+// Create or truncate filename and write size bytes starting at data with large write() calls.
+// Returns false if the file cannot be opened or a write fails.
+inline bool writeWholeFile(const std::string &filename, const unsigned char *data, std::size_t size)
+{
+   OutputFile file;
+   return file.open(filename) && file.write(data, size) && file.close();
+}
+
+/* DIRECTORIES */
+
+inline bool listFilesBelow(const std::string &directory, const std::string &prefix, std::vector<std::string> &files)
+{
+   DIR *stream = opendir(directory.c_str());
+   if (stream == NULL)
+   {
+      return false;
+   }
+
+   bool readable = true;
+   for (struct dirent *entry = readdir(stream); entry != NULL && readable; entry = readdir(stream))
+   {
+      std::string name(entry->d_name);
+      if (name == "." || name == "..")
+      {
+         continue;
+      }
+
+      // lstat, so symbolic links are neither followed nor listed
+      struct stat filestatus;
+      std::string path = directory + "/" + name;
+      if (lstat(path.c_str(), &filestatus) != 0)
+      {
+         continue;
+      }
+      if (S_ISDIR(filestatus.st_mode))
+      {
+         readable = listFilesBelow(path, prefix + name + "/", files);
+      }
+      else if (S_ISREG(filestatus.st_mode))
+      {
+         files.push_back(prefix + name);
+      }
+   }
+
+   closedir(stream);
+   return readable;
+}
+
+// List the regular files in directory and everything below it as '/' separated paths relative to directory,
+// sorted. Returns false if directory or one of its subdirectories cannot be read.
+inline bool listFiles(const std::string &directory, std::vector<std::string> &files)
+{
+   files.clear();
+   if (!listFilesBelow(directory, "", files))
+   {
+      return false;
+   }
+   std::sort(files.begin(), files.end());
+   return true;
+}
+
+// Create every missing directory on the way to the file path (mkdir -p of its parent).
+// Returns false if one of them cannot be created.
+inline bool makeParentDirectories(const std::string &path)
+{
+   for (std::size_t slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1))
+   {
+      std::string directory = path.substr(0, slash);
+      if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+      {
+         return false;
+      }
+   }
+   return true;
+}
+
+#endif
@@ -0,0 +1,83 @@
+/*
+   lzwLibrary435M.cpp
+
+   Lzw2Encoder and Lzw2Decoder, compiled once into the lzw library
+*/
+
+#include "lzwLibrary435M.hpp"
+
+/* ENCODER */
+
+Lzw2Encoder::Lzw2Encoder(const Lzw2Options &options, const Lzw2Dictionary *dictionary) : options(options), dictionary(dictionary)
+{
+   if (!isValidCodeWidth(options.maxCodeWidth))
+   {
+      throw "Unsupported lzw2 code width";
+   }
+   if (!isValidGrowthPolicy(options.growth))
+   {
+      throw "Unsupported lzw2 growth policy";
+   }
+   if (options.indexed && options.blockSize == 0)
+   {
+      throw "lzw2 block size must be positive";
+   }
+
+   // prime the dictionary now rather than in the first call
+   if (dictionary != NULL)
+   {
+      dictionary->presetFor(options);
+   }
+}
+
+void Lzw2Encoder::compress(const unsigned char *input, std::size_t size, std::vector<unsigned char> &out)
+{
+   out.clear();
+   writeLzw2(out, input, size, options, dictionary, workspace);
+}
+
+std::size_t Lzw2Encoder::compress(const unsigned char *input, std::size_t size, unsigned char *out, std::size_t capacity)
+{
+   // encoded in place; FixedOutput throws as soon as the stream outgrows capacity
+   FixedOutput output(out, capacity);
+   writeLzw2(output, input, size, options, dictionary, workspace);
+   return output.size();
+}
+
+/* DECODER */
+
+Lzw2Decoder::Lzw2Decoder(const Lzw2Dictionary *dictionary) : dictionary(dictionary) {}
+
+void Lzw2Decoder::decompress(const unsigned char *data, std::size_t size, std::vector<unsigned char> &out)
+{
+   out.clear();
+   readLzw2(data, size, dictionary, workspace, out);
+}
+
+std::size_t Lzw2Decoder::decompress(const unsigned char *data, std::size_t size, unsigned char *out, std::size_t capacity)
+{
+   Lzw2Options options = readLzw2Header(data, size, dictionary);
+   if ((options.checksummed() || options.indexed) && uncompressedSize(data, size) > capacity)
+   {
+      throw "lzw2 output buffer too small";
+   }
+
+   // decoded in place; FixedOutput throws as soon as the result outgrows capacity
+   FixedOutput output(out, capacity);
+   readLzw2(data, size, dictionary, workspace, output);
+   return output.size();
+}
+
+std::uint64_t Lzw2Decoder::uncompressedSize(const unsigned char *data, std::size_t size) const
+{
+   Lzw2Options options = readLzw2Header(data, size, dictionary);
+   if (options.checksummed())
+   {
+      return options.uncompressedSize;
+   }
+   if (options.indexed)
+   {
+      return readLzw2Index(data, size, dictionary).uncompressedSize;
+   }
+   throw "lzw2 stream does not record its size";
+}
@@ -0,0 +1,70 @@
+/*
+    lzwLibrary435M.hpp
+
+    the lzw compression Part 2 codec as a library (target lzw in CMakeLists.txt, built from lzwLibrary435M.cpp)
+    for programs that compress many messages, such as services, rather than one file per run
+
+    Lzw2Encoder and Lzw2Decoder keep everything a call needs between calls: the options, the preset dictionary
+    primed for them, the dictionary tables and the scratch buffers. once these have grown to fit the largest
+    message seen, coding another one allocates nothing. results go to a buffer owned by the caller, either a
+    vector whose capacity is reused or plain memory of a given capacity.
+
+    the streams are ordinary .lzw2 streams (lzwContainer435M.hpp), so lzw435M e expands them as well.
+    errors are thrown as a const char * describing them, as everywhere else in the codec. an encoder or decoder
+    (and the dictionary it uses) must not be used by two threads at once; give each thread its own.
+*/
+
+#ifndef LZWLIBRARY435M_HPP
+#define LZWLIBRARY435M_HPP
+
+#include "lzwContainer435M.hpp"
+
+class Lzw2Encoder
+{
+public:
+   // dictionary, when given, must outlive the encoder
+   explicit Lzw2Encoder(const Lzw2Options &options = Lzw2Options(), const Lzw2Dictionary *dictionary = NULL);
+
+   // Replace the contents of out with the .lzw2 stream of size bytes starting at input. out keeps its capacity,
+   // so a vector reused across calls stops being reallocated once it has fit the largest stream.
+   void compress(const unsigned char *input, std::size_t size, std::vector<unsigned char> &out);
+
+   // Write the .lzw2 stream of input to out, which has room for capacity bytes, and return its length.
+   // Throws as soon as the stream outgrows capacity. The stream is encoded straight into out.
+   std::size_t compress(const unsigned char *input, std::size_t size, unsigned char *out, std::size_t capacity);
+
+   const Lzw2Options &getOptions() const { return options; }
+
+private:
+   Lzw2Options options;
+   const Lzw2Dictionary *dictionary;
+   Lzw2Workspace workspace;
+};
+
+class Lzw2Decoder
+{
+public:
+   // dictionary, when given, must outlive the decoder. streams compressed with another dictionary are refused
+   explicit Lzw2Decoder(const Lzw2Dictionary *dictionary = NULL);
+
+   // Replace the contents of out with the original bytes of the .lzw2 stream of size bytes starting at data.
+   void decompress(const unsigned char *data, std::size_t size, std::vector<unsigned char> &out);
+
+   // Expand the .lzw2 stream to out, which has room for capacity bytes, and return the length of the original.
+   // Throws if it does not fit: before decoding when the stream records its size (see uncompressedSize), otherwise
+   // as soon as the output reaches capacity. Blocks are decoded straight into out, except with a preset dictionary,
+   // where each block is decoded behind the dictionary's history in the workspace and copied.
+   std::size_t decompress(const unsigned char *data, std::size_t size, unsigned char *out, std::size_t capacity);
+
+   // Size of the original of a .lzw2 stream, read from its header (or the trailer of an indexed version 1
+   // stream), so callers can size the output before decoding. Throws for version 1 streams without an index, and
+   // for sizes the stream cannot expand to (see isPlausibleUncompressedSize); range coded and lzmw or lzap streams
+   // have no such bound, so the size is only confirmed by decoding.
+   std::uint64_t uncompressedSize(const unsigned char *data, std::size_t size) const;
+
+private:
+   const Lzw2Dictionary *dictionary;
+   Lzw2Workspace workspace;
+};
+
+#endif
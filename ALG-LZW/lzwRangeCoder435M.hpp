@@ -0,0 +1,298 @@
+/*
+    lzwRangeCoder435M.hpp
+
+    optional entropy coding stage for lzw compression Part 2
+
+    instead of writing every code at the full width of the dictionary, the code stream can be run through an
+    adaptive binary range coder (the same scheme as LZMA). each code is split into
+        slot     : its bit length (0 for code 0, 1 for code 1, 9 for codes 256-511, ...), coded with a 5 bit tree
+        mantissa : the bits below the leading 1. the top RANGE_ADAPTIVE_BITS of them are coded with a bit tree
+                   per slot, the rest (only present in large dictionaries) are written as plain bits
+    every probability adapts to the data, so frequent codes (the literals and short, early phrases that
+    dominate LZW output) cost noticeably less than their fixed width. the stream of a block ends with
+    slot RANGE_END_SLOT, which no code can have.
+
+    the coder is sequential by nature: every bit depends on the range left by the previous one.
+
+    yes, I know I'm not supposed to put code in a header file
+*/
+
+#ifndef LZWRANGECODER435M_HPP
+#define LZWRANGECODER435M_HPP
+
+#include "lzwCodec435.hpp"
+#include <cstdint>
+
+const int RANGE_PROBABILITY_BITS = 11;                     // probabilities are 11 bit fixed point
+const int RANGE_ADAPT_SHIFT = 5;                           // each coded bit moves its probability 1/32 of the way
+const std::uint32_t RANGE_TOP = 1 << 24;                   // renormalize once the range drops below this
+const int RANGE_SLOT_BITS = 5;                             // slots 0-24 are code lengths, 25 ends the block
+const int RANGE_END_SLOT = LZW_MAX_CODE_WIDTH + 1;
+const int RANGE_ADAPTIVE_BITS = 8;                         // mantissa bits modelled per slot, the rest are sent raw
+
+// adaptive models for the slot and the mantissa bits of a code, shared by encoder and decoder
+struct RangeCodeModel
+{
+   std::vector<std::uint16_t> slot;     // bit tree over the slot
+   std::vector<std::uint16_t> mantissa; // one bit tree of 2^RANGE_ADAPTIVE_BITS nodes per slot
+
+   RangeCodeModel()
+      : slot(1 << RANGE_SLOT_BITS, 1 << (RANGE_PROBABILITY_BITS - 1)),
+        mantissa((RANGE_END_SLOT + 1) << RANGE_ADAPTIVE_BITS, 1 << (RANGE_PROBABILITY_BITS - 1)) {}
+
+   std::uint16_t *slotTree() { return &slot[0]; }
+   std::uint16_t *mantissaTree(int slotValue) { return &mantissa[slotValue << RANGE_ADAPTIVE_BITS]; }
+};
+
+// number of bits in code, 0 for code 0
+inline int codeSlot(int code)
+{
+   int slot = 0;
+   while (code >> slot)
+   {
+      ++slot;
+   }
+   return slot;
+}
+
+/* ENCODER */
+
+// Code sink range coding codes into out (a std::vector<unsigned char> or a FixedOutput, see lzwContainer435M.hpp).
+// flush() must be called once the block is done.
+template <typename Output>
+struct RangeCodeEncoder
+{
+   Output &out;
+   RangeCodeModel model;
+   std::uint64_t low;
+   std::uint32_t range;
+   unsigned char cache;
+   std::uint64_t cacheSize;
+
+   explicit RangeCodeEncoder(Output &out) : out(out), low(0), range(0xFFFFFFFF), cache(0), cacheSize(1) {}
+
+   // move the top byte of low out, holding back 0xFF bytes until a carry can no longer reach them
+   void shiftLow()
+   {
+      if ((std::uint32_t) low < 0xFF000000 || (low >> 32) != 0)
+      {
+         unsigned char carry = (unsigned char) (low >> 32);
+         unsigned char byte = cache;
+         do
+         {
+            out.push_back((unsigned char) (byte + carry));
+            byte = 0xFF;
+         } while (--cacheSize != 0);
+         cache = (unsigned char) (low >> 24);
+      }
+      ++cacheSize;
+      low = (low & 0x00FFFFFF) << 8;
+   }
+
+   void encodeBit(std::uint16_t &probability, int bit)
+   {
+      std::uint32_t bound = (range >> RANGE_PROBABILITY_BITS) * probability;
+      if (bit == 0)
+      {
+         range = bound;
+         probability += ((1 << RANGE_PROBABILITY_BITS) - probability) >> RANGE_ADAPT_SHIFT;
+      }
+      else
+      {
+         low += bound;
+         range -= bound;
+         probability -= probability >> RANGE_ADAPT_SHIFT;
+      }
+      while (range < RANGE_TOP)
+      {
+         range <<= 8;
+         shiftLow();
+      }
+   }
+
+   // bits with probability 1/2, no model
+   void encodeDirect(int value, int bitCount)
+   {
+      for (int i = bitCount - 1; i >= 0; --i)
+      {
+         range >>= 1;
+         if ((value >> i) & 1)
+         {
+            low += range;
+         }
+         while (range < RANGE_TOP)
+         {
+            range <<= 8;
+            shiftLow();
+         }
+      }
+   }
+
+   // code the bitCount low bits of value MSB-first down a bit tree of 2^bitCount nodes
+   void encodeTree(std::uint16_t *tree, int value, int bitCount)
+   {
+      int node = 1;
+      for (int i = bitCount - 1; i >= 0; --i)
+      {
+         int bit = (value >> i) & 1;
+         encodeBit(tree[node], bit);
+         node = (node << 1) | bit;
+      }
+   }
+
+   void encodeCode(int code)
+   {
+      int slot = codeSlot(code);
+      encodeTree(model.slotTree(), slot, RANGE_SLOT_BITS);
+
+      // the leading 1 is implied by the slot
+      int mantissaBits = slot - 1;
+      if (mantissaBits <= 0)
+      {
+         return;
+      }
+      int adaptiveBits = std::min(mantissaBits, RANGE_ADAPTIVE_BITS);
+      int rawBits = mantissaBits - adaptiveBits;
+      encodeTree(model.mantissaTree(slot), (code >> rawBits) & ((1 << adaptiveBits) - 1), adaptiveBits);
+      encodeDirect(code & ((1 << rawBits) - 1), rawBits);
+   }
+
+   void operator()(int code, int /* bound */) { encodeCode(code); }
+
+   // end the block and push out the rest of low
+   void flush()
+   {
+      encodeTree(model.slotTree(), RANGE_END_SLOT, RANGE_SLOT_BITS);
+      for (int i = 0; i < 5; ++i)
+      {
+         shiftLow();
+      }
+   }
+};
+
+/* DECODER */
+
+// Code source undoing RangeCodeEncoder, stopping at the end slot.
+struct RangeCodeDecoder
+{
+   const unsigned char *data;
+   const unsigned char *end;
+   RangeCodeModel model;
+   std::uint32_t range;
+   std::uint32_t code;
+   int overrun; // bytes asked for past the end of the block
+   bool finished;
+
+   RangeCodeDecoder(const unsigned char *data, std::size_t size)
+      : data(data), end(data + size), range(0xFFFFFFFF), code(0), overrun(0), finished(false)
+   {
+      for (int i = 0; i < 5; ++i)
+      {
+         code = (code << 8) | nextByte();
+      }
+   }
+
+   unsigned char nextByte()
+   {
+      if (data == end)
+      {
+         // a well formed block never needs more than the 5 flushed bytes; anything past that is a truncated stream
+         if (++overrun > 5)
+         {
+            throw "Truncated lzw2 entropy stream";
+         }
+         return 0;
+      }
+      return *data++;
+   }
+
+   int decodeBit(std::uint16_t &probability)
+   {
+      std::uint32_t bound = (range >> RANGE_PROBABILITY_BITS) * probability;
+      int bit;
+      if (code < bound)
+      {
+         range = bound;
+         probability += ((1 << RANGE_PROBABILITY_BITS) - probability) >> RANGE_ADAPT_SHIFT;
+         bit = 0;
+      }
+      else
+      {
+         code -= bound;
+         range -= bound;
+         probability -= probability >> RANGE_ADAPT_SHIFT;
+         bit = 1;
+      }
+      while (range < RANGE_TOP)
+      {
+         range <<= 8;
+         code = (code << 8) | nextByte();
+      }
+      return bit;
+   }
+
+   int decodeDirect(int bitCount)
+   {
+      int value = 0;
+      for (int i = 0; i < bitCount; ++i)
+      {
+         range >>= 1;
+         int bit = code >= range;
+         if (bit)
+         {
+            code -= range;
+         }
+         value = (value << 1) | bit;
+         while (range < RANGE_TOP)
+         {
+            range <<= 8;
+            code = (code << 8) | nextByte();
+         }
+      }
+      return value;
+   }
+
+   int decodeTree(std::uint16_t *tree, int bitCount)
+   {
+      int node = 1;
+      for (int i = 0; i < bitCount; ++i)
+      {
+         node = (node << 1) | decodeBit(tree[node]);
+      }
+      return node - (1 << bitCount);
+   }
+
+   bool operator()(int /* bound */, int &result)
+   {
+      if (finished)
+      {
+         return false;
+      }
+
+      int slot = decodeTree(model.slotTree(), RANGE_SLOT_BITS);
+      if (slot == RANGE_END_SLOT)
+      {
+         finished = true;
+         return false;
+      }
+      if (slot > LZW_MAX_CODE_WIDTH)
+      {
+         throw "Bad lzw2 entropy stream";
+      }
+      if (slot <= 1)
+      {
+         result = slot;
+         return true;
+      }
+
+      int mantissaBits = slot - 1;
+      int adaptiveBits = std::min(mantissaBits, RANGE_ADAPTIVE_BITS);
+      int rawBits = mantissaBits - adaptiveBits;
+      int high = decodeTree(model.mantissaTree(slot), adaptiveBits);
+      int low = decodeDirect(rawBits);
+      result = (1 << mantissaBits) | (high << rawBits) | low;
+      return true;
+   }
+};
+
+#endif
@@ -1,7 +1,7 @@
 /* 
     seamCarving.cpp
 
-    run with -> ./a [pgm image file] [# vertical seams to remove] [# horizontal seams to remove]
+    run with -> ./a [pgm image file] [# vertical seams to remove] [# horizontal seams to remove] [flags]
 
     seam carving changes the size of an image by removing the least visible pixels in the image. 
     the visibility of a pixel can be defined using an energy function. Seam carving can be done by finding a 
@@ -11,51 +11,142 @@
     Assumptions: 
         The pgm file provided adheres to the following format...
         
-        P2                       ; P2 designating greyscale image 
-        # Created by IrfanView   ; optional comment
+        P2                       ; P2 designating greyscale image in plain text, or P5 in binary
+        # Created by IrfanView   ; optional comments, anywhere in the header
         y x                      ; columns(y) by rows(x)
         255                      ; upper bound on values
         *                        ; pixel data begins here 
         *
         * 
 
-    Note: Several print statements have been commented out in main. These visualize each step of the process;
+    The file is mapped into memory and parsed in place (seamFileIO.hpp). the result is written in the format
+    of the input.
+
+    The image and the maps derived from it are each kept in one contiguous row-major buffer (Image<T>), with
+    8-bit pixels when the maximum grey value fits in a byte and 16-bit pixels otherwise. carving a seam shrinks
+    the logical width of a row without moving the rows apart, so no buffer is reallocated while carving.
+    on x86-64 the energy of interior pixels is computed 16 at a time with SSE2, or AVX2 where the processor has it.
+    both maps are computed by a pool of threads (seamThreadPool.hpp), one per CPU unless --threads says otherwise.
+    by default all vertical seams are removed before the horizontal ones; --optimal-order interleaves them in the
+    order of least removed energy (carveInOptimalOrder).
+
+    Note: Several print statements have been commented out in carveImage. These visualize each step of the process;
           uncomment them out for debugging help.
 */
 
 #include <iostream> 
-#include <fstream>
 #include <vector>
 #include <string> 
-#include <sstream>
 #include <cmath> 
 #include <algorithm>
 #include <utility> 
+#include <cstdint>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+
+#include "seamThreadPool.hpp"
+#include "seamFileIO.hpp"
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define SEAM_HAVE_X86_SIMD 1
+#endif
 
 using std::cout;
 using std::cerr;
 using std::endl;
-using std::getline;
-using std::ifstream;
-using std::ofstream;
 using std::vector;
 using std::string;
-using std::stringstream;
+
+// IMAGE
+
+/// @brief A 2D map of T (pixels, energies, ...) stored row-major in a single buffer.
+///        Rows start 'stride' elements apart; only the first 'columns' elements of each row are in use,
+///        so removing a seam shrinks 'columns' and leaves the buffer where it is.
+template <typename T>
+struct Image
+{
+    int rows;
+    int columns; // logical width
+    int stride;  // allocated width of a row
+    vector<T> data;
+
+    Image() : rows(0), columns(0), stride(0) {}
+    Image(int rows, int columns) : rows(rows), columns(columns), stride(columns), data((size_t) rows * columns) {}
+
+    T *row(int i) { return &data[(size_t) i * stride]; }
+    const T *row(int i) const { return &data[(size_t) i * stride]; }
+
+    T &operator()(int i, int j) { return data[(size_t) i * stride + j]; }
+    const T &operator()(int i, int j) const { return data[(size_t) i * stride + j]; }
+
+    /// @brief Give the map new dimensions, reusing the buffer whenever it is large enough. Contents are left unspecified.
+    void reshape(int newRows, int newColumns)
+    {
+        if (newColumns > stride || (size_t) newRows * stride > data.size())
+        {
+            stride = newColumns;
+            data.resize((size_t) newRows * newColumns);
+        }
+        rows = newRows;
+        columns = newColumns;
+    }
+};
+
+/// @brief The dimensions and grey value bound read from the header of a pgm file.
+struct PgmHeader
+{
+    int columns;
+    int rows;
+    int maxPixelValue;
+    bool binary;       // P5 rather than P2
+    size_t dataOffset; // where the pixel data starts in the file
+};
+
+/// @brief How the seams are to be carved, set by the optional flags following the seam counts.
+struct CarveOptions
+{
+    bool incrementalEnergy; // carry the energy map from seam to seam (--full-energy turns this off)
+    int threads;            // threads computing the maps (--threads=<n>)
+    int batchSize;          // seams taken from each cumulative energy map; above 1 the result is approximate (--batch=<k>)
+    bool optimalOrder;      // interleave vertical and horizontal seams by the transport map (--optimal-order)
+
+    CarveOptions() : incrementalEnergy(true), threads(defaultThreadCount()), batchSize(1), optimalOrder(false) {}
+};
 
 // CORE 
 
-vector<vector<int>> initImageMap(const string &filename);
-vector<vector<int>> initEnergyMap(const vector<vector<int>> &imageMap);
-vector<vector<int>> initCumulativeEnergyMap(const vector<vector<int>> &energyMap);
-void seamCarver(vector<vector<int>> &imageMap, const vector<vector<int>> &cumulativeEnergyMap);
+PgmHeader initImageHeader(const MappedFile &pgmInputFile);
+template <typename Pixel> void initImageMap(const MappedFile &pgmInputFile, const PgmHeader &header, Image<Pixel> &imageMap);
+template <typename Pixel> void initEnergyMap(const Image<Pixel> &imageMap, Image<int> &energyMap, bool horizontal, ThreadPool &pool);
+template <typename Pixel> void energyRows(const Image<Pixel> &imageMap, Image<int> &energyMap, int firstRow, int endRow);
+template <typename Pixel> void energyColumns(const Image<Pixel> &imageMap, Image<int> &energyMap, int firstColumn, int endColumn);
+void initCumulativeEnergyMap(const Image<int> &energyMap, Image<int> &cumulativeEnergyMap, Image<int8_t> &backpointers, ThreadPool &pool);
+template <typename Pixel> void updateEnergyMap(const Image<Pixel> &imageMap, Image<int> &energyMap, const vector<int> &seam, bool horizontal, ThreadPool &pool);
+template <typename Pixel> void updateEnergyRows(const Image<Pixel> &imageMap, Image<int> &energyMap, const vector<int> &seam, int firstRow, int endRow);
+template <typename Pixel> void updateEnergyColumns(const Image<Pixel> &imageMap, Image<int> &energyMap, const vector<int> &seam, int firstColumn, int endColumn);
+template <typename Pixel> void seamCarver(Image<Pixel> &imageMap, const Image<int> &cumulativeEnergyMap, const Image<int8_t> &backpointers,
+                                          bool horizontal, vector<int> &seam_indices, ThreadPool &pool);
+int findSeamBatch(const Image<int> &cumulativeEnergyMap, const Image<int8_t> &backpointers, int count, vector<int> &seams, Image<uint8_t> &taken);
+template <typename Pixel> void carveSeamBatches(Image<Pixel> &imageMap, int num_seams, bool horizontal, int batchSize,
+                                                Image<int> &E, Image<int> &CE, Image<int8_t> &B, ThreadPool &pool);
+template <typename Pixel> string carveInOptimalOrder(Image<Pixel> &imageMap, int num_vertical_seams, int num_horizontal_seams, bool incrementalEnergy,
+                                                     ThreadPool &pool);
+template <typename Pixel> void carveImage(const MappedFile &pgmInputFile, const PgmHeader &header, const string &fullname, int num_vertical_seams, int num_horizontal_seams,
+                                          const CarveOptions &options);
 
 // HELPERS
 
-void transposeMap(vector<vector<int>> &imageMap);
-void displayMap(const vector<vector<int>> &map);
-void displayTranspose(const vector<vector<int>> &map);
-void validateCarveRequests(const vector<vector<int>> &imageMap, int num_vertical_seams, int num_horizontal_seams);
-void writeResults(const vector<vector<int>> &imageMap, const string &filename);
+template <typename T> void removeSeam(Image<T> &map, const vector<int> &seam, int firstRow, int endRow);
+template <typename T> void removeHorizontalSeam(Image<T> &map, const vector<int> &seam, int firstColumn, int endColumn);
+template <typename T> void removeSeams(Image<T> &map, const vector<int> &seams, int count, bool horizontal, ThreadPool &pool);
+template <typename T> void removeHorizontalSeams(Image<T> &map, const vector<int> &seams, int count, int firstColumn, int endColumn);
+template <typename T> void displayMap(const Image<T> &map);
+template <typename T> void displayTranspose(const Image<T> &map);
+void validateCarveRequests(const PgmHeader &header, int num_vertical_seams, int num_horizontal_seams);
+CarveOptions parseCarveOptions(int argc, char* argv[]);
+template <typename Pixel> void writeResults(const Image<Pixel> &imageMap, const string &filename, bool binary);
 
 int main(int argc, char* argv[]) 
 {
@@ -65,84 +156,177 @@ int main(int argc, char* argv[])
     cout << "|______________________________________________________|\n\n";
 
     // VALIDATE ARGUMENTS
-    if(argc != 4) 
+    if(argc < 4) 
     {
         cerr << "error: invalid command-line arguments\n"
-             << "format of valid program invocation: ./a [pgm image file] [# vertical seams to remove] [# horizontal seams to remove]\n";
+             << "format of valid program invocation: ./a [pgm image file] [# vertical seams to remove] [# horizontal seams to remove] [flags]\n";
         exit(1);
     }
+    CarveOptions options = parseCarveOptions(argc, argv);
 
-    // INITIALIZE THE IMAGE MAP 
+    // OPEN THE IMAGE FILE
     string fullname = string(argv[1]);
-    vector<vector<int>> I = initImageMap(fullname);
+    MappedFile pgmInputFile;
+
+    // validate good connection to the input file
+    if (!pgmInputFile.open(fullname)) 
+    {
+        cerr << "error: could not open file '" << fullname << "'\n"
+             << "check the file name is correct and the file is located at the same directory level as the executable\n";
+        exit(1);
+    }
+
+    PgmHeader header = initImageHeader(pgmInputFile);
 
     // validate command-line args for vertical/horizontal carve requests
     int num_vertical_seams = atoi(argv[2]);
     int num_horizontal_seams = atoi(argv[3]);
-    validateCarveRequests(I, num_vertical_seams, num_horizontal_seams);
+    validateCarveRequests(header, num_vertical_seams, num_horizontal_seams);
+
+    // pixels take a byte each unless the grey values need two
+    if (header.maxPixelValue <= UINT8_MAX)
+    {
+        carveImage<uint8_t>(pgmInputFile, header, fullname, num_vertical_seams, num_horizontal_seams, options);
+    }
+    else
+    {
+        carveImage<uint16_t>(pgmInputFile, header, fullname, num_vertical_seams, num_horizontal_seams, options);
+    }
+
+    return 0;
+}
 
-    // cout << "'" << argv[1] << "' --> Initial Image Map:\n";
+/// @brief Carve the requested seams out of the image whose header has been read from pgmInputFile and write
+///        the result next to it, for pixels of type Pixel.
+/// @param pgmInputFile The mapped pgm file.
+/// @param header The header read by initImageHeader.
+/// @param fullname Name of the pgm file, from which the name of the result is derived.
+/// @param num_vertical_seams Number of vertical seams to remove.
+/// @param num_horizontal_seams Number of horizontal seams to remove.
+/// @param options How to carve them.
+template <typename Pixel>
+void carveImage(const MappedFile &pgmInputFile, const PgmHeader &header, const string &fullname, int num_vertical_seams, int num_horizontal_seams,
+                const CarveOptions &options)
+{
+    // INITIALIZE THE IMAGE MAP 
+    Image<Pixel> I;
+    initImageMap(pgmInputFile, header, I);
+
+    // the energy and cumulative energy maps are allocated once and reshaped to the image before every seam.
+    // in incremental mode E is carried forward from one seam to the next and only computed in full when
+    // it does not match I (at the start, and for the horizontal seams, which lay it out by columns)
+    Image<int> E;
+    Image<int> CE;
+    Image<int8_t> B; // backpointers of CE
+    vector<int> seam;
+    ThreadPool pool(options.threads);
+    bool energyIsCurrent = false;
+
+    // cout << "'" << fullname << "' --> Initial Image Map:\n";
     // displayMap(I);
 
+    // CARVE THE REQUESTED VERTICAL AND HORIZONTAL SEAMS TOGETHER, IN THE ORDER OF LEAST ENERGY
+    if (options.optimalOrder)
+    {
+        // the horizontal seams are carved here as well, so the horizontal block below is skipped
+        string order = carveInOptimalOrder(I, num_vertical_seams, num_horizontal_seams, options.incrementalEnergy, pool);
+        cout << "Seam order: " << order << "\n";
+    }
     // CARVE THE REQUESTED NUMBER OF VERTICAL SEAMS
-    for (int i = 1; i <= num_vertical_seams; ++i)
+    else if (options.batchSize > 1)
+    {
+        // approximate mode, several seams from each cumulative energy map
+        carveSeamBatches(I, num_vertical_seams, false, options.batchSize, E, CE, B, pool);
+    }
+    else
     {
-        cout << "\n[C][A][R][V][I][N][G] [V[E][R][T][I][C][A][L] [S][E][A][M] [" << i << "]\n";
+        for (int i = 1; i <= num_vertical_seams; ++i)
+        {
+            cout << "\n[C][A][R][V][I][N][G] [V[E][R][T][I][C][A][L] [S][E][A][M] [" << i << "]\n";
 
-        // cout << "\nInitial Image Map:\n";
-        // displayMap(I);
+            // cout << "\nInitial Image Map:\n";
+            // displayMap(I);
 
-        // INITIALIZE THE ENERGY MAP
-        vector<vector<int>> E = initEnergyMap(I);
+            // INITIALIZE THE ENERGY MAP
+            if (!energyIsCurrent)
+            {
+                initEnergyMap(I, E, false, pool);
+            }
         
-        // cout << "\nEnergy Map: \n";
-        // displayMap(E);
+            // cout << "\nEnergy Map: \n";
+            // displayMap(E);
 
-        // INITIALIZE THE CUMULATIVE ENERGY MAP 
-        vector<vector<int>> CE = initCumulativeEnergyMap(E);
+            // INITIALIZE THE CUMULATIVE ENERGY MAP 
+            initCumulativeEnergyMap(E, CE, B, pool);
 
-        // cout << "\nCumulative Energy Map: \n";
-        // displayMap(CE);
+            // cout << "\nCumulative Energy Map: \n";
+            // displayMap(CE);
+
+            // CARVE OUT A SEAM
+            seamCarver(I, CE, B, false, seam, pool); 
 
-        // CARVE OUT A SEAM
-        seamCarver(I, CE); 
+            // UPDATE THE ENERGY MAP FOR THE NEXT SEAM
+            if (options.incrementalEnergy)
+            {
+                updateEnergyMap(I, E, seam, false, pool);
+                energyIsCurrent = true;
+            }
 
-        // cout << "\nSeam-Carved Image Map: \n";
-        // displayMap(I);
+            // cout << "\nSeam-Carved Image Map: \n";
+            // displayMap(I);
+        }
     }
 
     // CARVE THE REQUESTED NUMBER OF HORIZONATL SEAMS
-    if (num_horizontal_seams > 0)
+    if (num_horizontal_seams > 0 && !options.optimalOrder)
     {    
-        // if-block protects against unecessarily transposing the image map
+        // if-block protects against carving the horizontal seams a second time when they went in the optimal order above.
+        // the horizontal seams are carved along the columns of I where it lies, without transposing it; only the
+        // energy map is laid out by columns (see initEnergyMap), so it is computed afresh
 
-        transposeMap(I); // transpose the map to reuse the vertical seam carver for horizontal seams
-        for (int i = 1; i <= num_horizontal_seams; ++i)
+        energyIsCurrent = false;
+        if (options.batchSize > 1)
         {
-            cout << "\n[C][A][R][V][I][N][G] [H[O][R][I][Z][O][N][T][A][L] [S][E][A][M] [" << i << "]\n";
+            carveSeamBatches(I, num_horizontal_seams, true, options.batchSize, E, CE, B, pool);
+        }
+        else
+        {
+            for (int i = 1; i <= num_horizontal_seams; ++i)
+            {
+                cout << "\n[C][A][R][V][I][N][G] [H[O][R][I][Z][O][N][T][A][L] [S][E][A][M] [" << i << "]\n";
 
-            // cout << "\nInitial Image Map:\n";
-            // displayTranspose(I);
+                // cout << "\nInitial Image Map:\n";
+                // displayMap(I);
 
-            // INITIALIZE THE ENERGY MAP
-            vector<vector<int>> E = initEnergyMap(I);
+                // INITIALIZE THE ENERGY MAP
+                if (!energyIsCurrent)
+                {
+                    initEnergyMap(I, E, true, pool);
+                }
             
-            // cout << "\nEnergy Map: \n";
-            // displayTranspose(E);
+                // cout << "\nEnergy Map: \n";
+                // displayTranspose(E);
 
-            // INITIALIZE THE CUMULATIVE ENERGY MAP 
-            vector<vector<int>> CE = initCumulativeEnergyMap(E);
+                // INITIALIZE THE CUMULATIVE ENERGY MAP (one row per column of I)
+                initCumulativeEnergyMap(E, CE, B, pool);
 
-            // cout << "\nCumulative Energy Map: \n";
-            // displayTranspose(CE);
+                // cout << "\nCumulative Energy Map: \n";
+                // displayTranspose(CE);
 
-            // CARVE OUT A SEAM
-            seamCarver(I, CE); 
+                // CARVE OUT A SEAM
+                seamCarver(I, CE, B, true, seam, pool); 
 
-            // cout << "\nSeam-Carved Image Map: \n";
-            // displayTranspose(I);
+                // UPDATE THE ENERGY MAP FOR THE NEXT SEAM
+                if (options.incrementalEnergy)
+                {
+                    updateEnergyMap(I, E, seam, true, pool);
+                    energyIsCurrent = true;
+                }
+
+                // cout << "\nSeam-Carved Image Map: \n";
+                // displayMap(I);
+            }
         }
-        transposeMap(I); // undo the transpose
     }
 
     // WRITE RESULTS TO FILE
@@ -154,60 +338,91 @@ int main(int argc, char* argv[])
     string fileToWrite = rawname + "_processed_" + std::to_string(num_vertical_seams) + "_" + std::to_string(num_horizontal_seams) + ".pgm";
 
     // write the processed image to fileToWrite
-    writeResults(I, fileToWrite);
+    writeResults(I, fileToWrite, header.binary);
 
     cout << "\nEND PROCESSING\n";
     cout << "Results written to '" << fileToWrite << "' \n";
-    
-    return 0;
 }
 
-/// @brief A 2D vector of integers is populated with the image pixel values comprising the pgm image file, 'filename'.
-/// @param filename Name of a file with a pgm extension.
-/// @return The resultant image map by value.
-/// @note initImageMap assumes the pgm file format outlined in the project description is rigorously adhered to. 
-///       Noteably, a hard assumption is made that one optional comment is in the file, necessarily on line two (if it exists).
-vector<vector<int>> initImageMap(const string &filename)
+/// @brief Whether c separates the tokens of a pgm file.
+inline bool isPgmSpace(char c)
 {
-    ifstream pgmInputFile(filename);
- 
-    // validate good connection to the input file
-    if (!pgmInputFile) 
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+inline bool isDigit(char c)
+{
+    return (unsigned char) (c - '0') <= 9;
+}
+
+/// @brief Read the next number of the pgm header, skipping whitespace and comments ('#' to the end of the line) before it.
+/// @param data The mapped pgm file.
+/// @param size Its length in bytes.
+/// @param position Where to start; left just past the number.
+/// @return The number, or -1 if something else comes first or it does not fit in an int.
+int readHeaderNumber(const char *data, size_t size, size_t &position)
+{
+    while (position < size && (isPgmSpace(data[position]) || data[position] == '#'))
     {
-        cerr << "error: could not open file '" << filename << "'\n"
-             << "check the file name is correct and the file is located at the same directory level as the executable\n";
-        exit(1);
+        if (data[position] == '#')
+        {
+            while (position < size && data[position] != '\n')
+            {
+                ++position;
+            }
+        }
+        else
+        {
+            ++position;
+        }
+    }
+
+    if (position == size || !isDigit(data[position]))
+    {
+        return -1;
+    }
+    long long number = 0;
+    for (; position < size && isDigit(data[position]); ++position)
+    {
+        number = number * 10 + (data[position] - '0');
+        if (number > INT_MAX)
+        {
+            return -1;
+        }
     }
+    return (int) number;
+}
 
+/// @brief The header of the pgm image file mapped by pgmInputFile is parsed.
+/// @param pgmInputFile The mapped pgm file.
+/// @return The format, image dimensions and maximum grey value, and where the pixel data starts.
+/// @note Both plain (P2) and binary (P5) pgm files are read. Comments may appear anywhere in the header, as the
+///       pgm format allows; the single whitespace character after the maximum grey value ends it.
+PgmHeader initImageHeader(const MappedFile &pgmInputFile)
+{
     // #REGION parse_to_data 
-    string temp_line;
-    
-    // handle file format line
-    getline(pgmInputFile, temp_line); // "P2"
-    if (temp_line != "P2") 
+    const char *data = pgmInputFile.data();
+    size_t size = pgmInputFile.size();
+
+    // handle file format
+    if (size < 2 || data[0] != 'P' || (data[1] != '2' && data[1] != '5'))
     { 
-        // this program handles only P2 images, meaning colors must be in greyscale
+        // this program handles only greyscale images
+        size_t length = 0;
+        while (length < size && length < 16 && !isPgmSpace(data[length]))
+        {
+            ++length;
+        }
         cerr << "error: invalid pgm file format\n"
-             << "file format was read as '" << temp_line << "', while the supported format is 'P2' for a PGM file\n";
+             << "file format was read as '" << string(data, length) << "', while the supported formats are 'P2' and 'P5' for a PGM file\n";
         exit(1);
     }
+    size_t position = 2;
 
-    // @NOTE - crucially, the code here assumes line two of the header is the singular comment-line, or there are no comments in the file at all
-    if (pgmInputFile.peek() == '#') 
-    { 
-        getline(pgmInputFile, temp_line); // skip optional comment
-    }
-
-    getline(pgmInputFile, temp_line); // columns X rows
-
-    // parse out the column and row count from this line
-    int columns = 0, rows = 0;
-    stringstream dimensions;      
-    dimensions << temp_line;       // read entire line into string stream
-    dimensions >> columns >> rows; // write whitespace seperated values into variables
-
-    // something went wrong if these are still 0
-    if (columns == 0 || rows == 0)
+    // columns X rows
+    int columns = readHeaderNumber(data, size, position);
+    int rows = readHeaderNumber(data, size, position);
+    if (columns <= 0 || rows <= 0)
     {
         // an error occured in reading the image dimensions
         cerr << "error: a problem occured in reading the pgm file dimensions\n"
@@ -215,110 +430,674 @@ vector<vector<int>> initImageMap(const string &filename)
         exit(1);
     }
 
-    getline(pgmInputFile, temp_line); // maximum greyscale value
-    int maxPixelValue = stoi(temp_line);
+    // maximum greyscale value
+    int maxPixelValue = readHeaderNumber(data, size, position);
+
+    // pgm grey values are at most 16 bits
+    if (maxPixelValue <= 0 || maxPixelValue > UINT16_MAX)
+    {
+        cerr << "error: the maximum grey value of the pgm file is " << maxPixelValue << ", while the supported range is [1, " << UINT16_MAX << "]\n";
+        exit(1);
+    }
     // #ENDREGION
 
+    PgmHeader header;
+    header.columns = columns;
+    header.rows = rows;
+    header.maxPixelValue = maxPixelValue;
+    header.binary = data[1] == '5';
+    header.dataOffset = position + 1; // past the whitespace ending the header
+    return header;
+}
+
+/// @brief An image map is populated with the pixel values following the header of a pgm image file.
+/// @param pgmInputFile The mapped pgm file.
+/// @param header The header read by initImageHeader.
+/// @param imageMap The image map to fill, reshaped to the dimensions given by header.
+/// @note Binary pixels are copied a row at a time (16-bit ones are stored most significant byte first).
+///       Plain pixels are parsed straight from the mapping, one digit at a time.
+template <typename Pixel>
+void initImageMap(const MappedFile &pgmInputFile, const PgmHeader &header, Image<Pixel> &imageMap)
+{
+    const char *data = pgmInputFile.data() + std::min(header.dataOffset, pgmInputFile.size());
+    const char *end = pgmInputFile.data() + pgmInputFile.size();
+
+    imageMap.reshape(header.rows, header.columns);
+
     // #REGION parse_data
-    // read raw pixel data into a string, and subsequently into a stringstream
-    string pixelData;
-    stringstream ssPixelData;
-    while (!pgmInputFile.eof())
+    if (header.binary)
     {
-        // grab a row of data
-        getline(pgmInputFile, temp_line); 
-
-        // if temp_line does not end in a whitespace we will append one ourself 
-        if (temp_line[temp_line.size() - 1] != ' ')
+        int bytesPerPixel = header.maxPixelValue > UINT8_MAX ? 2 : 1;
+        if ((size_t) (end - data) < (size_t) header.rows * header.columns * bytesPerPixel)
         {
-            temp_line.append(" ");
+            cerr << "error: the pgm file ends before all of its " << header.rows << " x " << header.columns << " pixels were read\n";
+            exit(1);
         }
 
-        // append to the result string
-        pixelData += temp_line;
+        const unsigned char *bytes = (const unsigned char *) data;
+        for (int i = 0; i < header.rows; ++i, bytes += (size_t) header.columns * bytesPerPixel)
+        {
+            Pixel *rowResult = imageMap.row(i);
+            if (sizeof(Pixel) == 1 && bytesPerPixel == 1)
+            {
+                memcpy(rowResult, bytes, header.columns);
+            }
+            else
+            {
+                for (int j = 0; j < header.columns; ++j)
+                {
+                    rowResult[j] = bytesPerPixel == 1 ? bytes[j] : (Pixel) (bytes[2 * j] << 8 | bytes[2 * j + 1]);
+                }
+            }
+
+            // a full range of 8 or 16 bits cannot be exceeded
+            if (header.maxPixelValue != UINT8_MAX && header.maxPixelValue != UINT16_MAX &&
+                *std::max_element(rowResult, rowResult + header.columns) > header.maxPixelValue)
+            {
+                cerr << "error: a pixel value exists in the image data which falls outside the given acceptable range of [0, " << header.maxPixelValue << "]\n";
+                exit(1);
+            }
+        }
+        return;
     }
-    ssPixelData << pixelData;
 
-    // populate a 2D vector with the data
-    vector<vector<int>> result;
-    int pixel = 0;
-    for (int i = 0; i < rows; ++i)
+    for (int i = 0; i < header.rows; ++i)
     {
         // outer-for iterates over rows
 
-        vector<int> rowResult;
-        for (int j = 0; j < columns; ++j)
+        Pixel *rowResult = imageMap.row(i);
+        for (int j = 0; j < header.columns; ++j)
         {
             // inner-for iterates over individual pixels in each row
-            ssPixelData >> pixel;
+
+            // skip the whitespace, and any comment, up to the next number
+            while (data < end && !isDigit(*data))
+            {
+                if (*data == '#')
+                {
+                    data = std::find(data, end, '\n');
+                }
+                else if (isPgmSpace(*data))
+                {
+                    ++data;
+                }
+                else
+                {
+                    cerr << "error: unexpected character '" << *data << "' in the pixel data of the pgm file\n";
+                    exit(1);
+                }
+            }
+            if (data == end)
+            {
+                cerr << "error: the pgm file ends before all of its " << header.rows << " x " << header.columns << " pixels were read\n";
+                exit(1);
+            }
+
+            // stop accumulating once past the largest grey value, so long runs of digits cannot overflow
+            int pixel = 0;
+            do
+            {
+                pixel = pixel * 10 + (*data++ - '0');
+            } while (data < end && isDigit(*data) && pixel <= UINT16_MAX);
 
             // ensure the pixel is within the valid range of values
-            if (pixel > maxPixelValue || pixel < 0)
+            if (pixel > header.maxPixelValue || (data < end && isDigit(*data)))
             {
-                cerr << "error: a pixel value exists in the image data which falls outside the given acceptable range of [0, " << maxPixelValue << "]\n";
+                cerr << "error: a pixel value exists in the image data which falls outside the given acceptable range of [0, " << header.maxPixelValue << "]\n";
                 exit(1);
             }
             
-            rowResult.push_back(pixel);
+            rowResult[j] = (Pixel) pixel;
         }
-        
-        result.push_back(rowResult);
     }
     // #ENDREGION
+}
+
+/// @brief The energy of the pixel at row i, column j of an image map: the sum of its absolute differences
+///        to the pixels left, right, above and below it. A neighbor beyond the border counts as the pixel itself.
+template <typename Pixel>
+inline int pixelEnergy(const Image<Pixel> &imageMap, int i, int j)
+{
+    const Pixel *pixels = imageMap.row(i);
+    int pixel = pixels[j];
+
+    // #REGION find ΔI along X axis 
+    // bounds checking X
+    int left = (j - 1) >= 0 ? pixels[j - 1] : pixel; 
+    int right = (j + 1) < imageMap.columns ? pixels[j + 1] : pixel;
+
+    int changeX = abs(pixel - left) + abs(pixel - right);
+    // #ENDREGION
+
+    // #REGION find ΔI along Y axis 
+    // bounds checking Y
+    int up = (i - 1) >= 0 ? imageMap(i - 1, j) : pixel;
+    int down = (i + 1) < imageMap.rows ? imageMap(i + 1, j) : pixel;
+
+    int changeY = abs(pixel - up) + abs(pixel - down);
+    // #ENDREGION
+
+    return changeX + changeY;
+}
+
+// #REGION interior energy kernels
+// a pixel whose four neighbors all exist needs no bounds checks, so the interior columns [begin, end) of an interior
+// row are computed in runs. the vector kernels do as many whole vectors as fit and return the column they stopped at;
+// the scalar kernel finishes the rest. all of them give exactly the energies pixelEnergy gives.
+
+template <typename Pixel>
+inline void energyRowScalar(const Pixel *up, const Pixel *pixels, const Pixel *down, int *result, int begin, int end)
+{
+    for (int j = begin; j < end; ++j)
+    {
+        int pixel = pixels[j];
+        result[j] = abs(pixel - pixels[j - 1]) + abs(pixel - pixels[j + 1]) + abs(pixel - up[j]) + abs(pixel - down[j]);
+    }
+}
+
+#ifdef SEAM_HAVE_X86_SIMD
+
+// |a - b| of unsigned lanes is (a - b) | (b - a) with saturating subtraction, one of which is 0
+inline __m128i absDiffU8(__m128i a, __m128i b) { return _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)); }
+inline __m128i absDiffU16(__m128i a, __m128i b) { return _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a)); }
+
+/// @brief SSE2 kernel for 8-bit pixels: 16 pixels per step, summed as 16-bit lanes (at most 4 * 255).
+inline int energyRowSse2(const uint8_t *up, const uint8_t *pixels, const uint8_t *down, int *result, int begin, int end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int j = begin;
+    for (; j + 16 <= end; j += 16)
+    {
+        __m128i pixel = _mm_loadu_si128((const __m128i *) (pixels + j));
+        __m128i changeLeft = absDiffU8(pixel, _mm_loadu_si128((const __m128i *) (pixels + j - 1)));
+        __m128i changeRight = absDiffU8(pixel, _mm_loadu_si128((const __m128i *) (pixels + j + 1)));
+        __m128i changeUp = absDiffU8(pixel, _mm_loadu_si128((const __m128i *) (up + j)));
+        __m128i changeDown = absDiffU8(pixel, _mm_loadu_si128((const __m128i *) (down + j)));
+
+        __m128i low = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(changeLeft, zero), _mm_unpacklo_epi8(changeRight, zero)),
+                                    _mm_add_epi16(_mm_unpacklo_epi8(changeUp, zero), _mm_unpacklo_epi8(changeDown, zero)));
+        __m128i high = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(changeLeft, zero), _mm_unpackhi_epi8(changeRight, zero)),
+                                     _mm_add_epi16(_mm_unpackhi_epi8(changeUp, zero), _mm_unpackhi_epi8(changeDown, zero)));
+
+        _mm_storeu_si128((__m128i *) (result + j), _mm_unpacklo_epi16(low, zero));
+        _mm_storeu_si128((__m128i *) (result + j + 4), _mm_unpackhi_epi16(low, zero));
+        _mm_storeu_si128((__m128i *) (result + j + 8), _mm_unpacklo_epi16(high, zero));
+        _mm_storeu_si128((__m128i *) (result + j + 12), _mm_unpackhi_epi16(high, zero));
+    }
+    return j;
+}
+
+/// @brief SSE2 kernel for 16-bit pixels: 8 pixels per step, summed as 32-bit lanes (4 * 65535 needs 18 bits).
+inline int energyRowSse2(const uint16_t *up, const uint16_t *pixels, const uint16_t *down, int *result, int begin, int end)
+{
+    const __m128i zero = _mm_setzero_si128();
+    int j = begin;
+    for (; j + 8 <= end; j += 8)
+    {
+        __m128i pixel = _mm_loadu_si128((const __m128i *) (pixels + j));
+        __m128i changeLeft = absDiffU16(pixel, _mm_loadu_si128((const __m128i *) (pixels + j - 1)));
+        __m128i changeRight = absDiffU16(pixel, _mm_loadu_si128((const __m128i *) (pixels + j + 1)));
+        __m128i changeUp = absDiffU16(pixel, _mm_loadu_si128((const __m128i *) (up + j)));
+        __m128i changeDown = absDiffU16(pixel, _mm_loadu_si128((const __m128i *) (down + j)));
+
+        __m128i low = _mm_add_epi32(_mm_add_epi32(_mm_unpacklo_epi16(changeLeft, zero), _mm_unpacklo_epi16(changeRight, zero)),
+                                    _mm_add_epi32(_mm_unpacklo_epi16(changeUp, zero), _mm_unpacklo_epi16(changeDown, zero)));
+        __m128i high = _mm_add_epi32(_mm_add_epi32(_mm_unpackhi_epi16(changeLeft, zero), _mm_unpackhi_epi16(changeRight, zero)),
+                                     _mm_add_epi32(_mm_unpackhi_epi16(changeUp, zero), _mm_unpackhi_epi16(changeDown, zero)));
+
+        _mm_storeu_si128((__m128i *) (result + j), low);
+        _mm_storeu_si128((__m128i *) (result + j + 4), high);
+    }
+    return j;
+}
+
+// absDiffU8 on 32 lanes
+__attribute__((target("avx2"))) inline __m256i absDiffU8Avx2(__m256i a, __m256i b)
+{
+    return _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+}
+
+/// @brief AVX2 kernel for 8-bit pixels: 32 pixels per step. The differences are taken on bytes, then summed as 16-bit
+///        lanes; the in-lane unpacks leave pixels 0-7 and 16-23 in low, 8-15 and 24-31 in high.
+__attribute__((target("avx2"))) inline int energyRowAvx2(const uint8_t *up, const uint8_t *pixels, const uint8_t *down, int *result,
+                                                         int begin, int end)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    int j = begin;
+    for (; j + 32 <= end; j += 32)
+    {
+        __m256i pixel = _mm256_loadu_si256((const __m256i *) (pixels + j));
+        __m256i changeLeft = absDiffU8Avx2(pixel, _mm256_loadu_si256((const __m256i *) (pixels + j - 1)));
+        __m256i changeRight = absDiffU8Avx2(pixel, _mm256_loadu_si256((const __m256i *) (pixels + j + 1)));
+        __m256i changeUp = absDiffU8Avx2(pixel, _mm256_loadu_si256((const __m256i *) (up + j)));
+        __m256i changeDown = absDiffU8Avx2(pixel, _mm256_loadu_si256((const __m256i *) (down + j)));
+
+        __m256i low = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(changeLeft, zero), _mm256_unpacklo_epi8(changeRight, zero)),
+                                       _mm256_add_epi16(_mm256_unpacklo_epi8(changeUp, zero), _mm256_unpacklo_epi8(changeDown, zero)));
+        __m256i high = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(changeLeft, zero), _mm256_unpackhi_epi8(changeRight, zero)),
+                                        _mm256_add_epi16(_mm256_unpackhi_epi8(changeUp, zero), _mm256_unpackhi_epi8(changeDown, zero)));
+
+        _mm256_storeu_si256((__m256i *) (result + j), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(low)));
+        _mm256_storeu_si256((__m256i *) (result + j + 8), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(high)));
+        _mm256_storeu_si256((__m256i *) (result + j + 16), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(low, 1)));
+        _mm256_storeu_si256((__m256i *) (result + j + 24), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(high, 1)));
+    }
+    return j;
+}
+
+/// @brief AVX2 kernel for 16-bit pixels: 8 pixels per step, widened to 32-bit lanes before the differences.
+__attribute__((target("avx2"))) inline int energyRowAvx2(const uint16_t *up, const uint16_t *pixels, const uint16_t *down, int *result,
+                                                         int begin, int end)
+{
+    int j = begin;
+    for (; j + 8 <= end; j += 8)
+    {
+        __m256i pixel = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (pixels + j)));
+        __m256i left = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (pixels + j - 1)));
+        __m256i right = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (pixels + j + 1)));
+        __m256i upper = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (up + j)));
+        __m256i lower = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (down + j)));
+
+        __m256i energy = _mm256_add_epi32(_mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(pixel, left)), _mm256_abs_epi32(_mm256_sub_epi32(pixel, right))),
+                                          _mm256_add_epi32(_mm256_abs_epi32(_mm256_sub_epi32(pixel, upper)), _mm256_abs_epi32(_mm256_sub_epi32(pixel, lower))));
+
+        _mm256_storeu_si256((__m256i *) (result + j), energy);
+    }
+    return j;
+}
+
+#endif
 
-    return result;
+/// @brief Energies of the columns [begin, end) of a row whose four neighbors all exist, with the widest kernel available.
+/// @param up The row above, pixels the row itself and down the row below.
+template <typename Pixel>
+inline void energyRowInterior(const Pixel *up, const Pixel *pixels, const Pixel *down, int *result, int begin, int end)
+{
+#ifdef SEAM_HAVE_X86_SIMD
+    // SSE2 is part of x86-64, AVX2 is not, so ask the processor once
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2)
+    {
+        begin = energyRowAvx2(up, pixels, down, result, begin, end);
+    }
+    begin = energyRowSse2(up, pixels, down, result, begin, end);
+#endif
+    energyRowScalar(up, pixels, down, result, begin, end);
+}
+// #ENDREGION
+
+/// @brief An energy map is populated with pixel energy values using an image map produced by initImageMap.
+/// @param imageMap The image map containing the pixel data of a pgm file
+/// @param energyMap The resultant energy map, reshaped to the dimensions of imageMap. For horizontal seams it is laid
+///        out one row per column of imageMap instead (energyMap(j, i) is the energy of pixel (i, j)), so that
+///        a horizontal seam crosses its rows the way a vertical seam crosses the rows of the image, and the
+///        cumulative energy map and seam are found by the same code for both.
+/// @param horizontal Whether the map is for carving horizontal seams.
+/// @param pool The threads to share the rows (or columns) between.
+template <typename Pixel>
+void initEnergyMap(const Image<Pixel> &imageMap, Image<int> &energyMap, bool horizontal, ThreadPool &pool)
+{
+    if (horizontal)
+    {
+        energyMap.reshape(imageMap.columns, imageMap.rows);
+        pool.runRange(0, imageMap.columns, [&](int firstColumn, int endColumn)
+        {
+            energyColumns(imageMap, energyMap, firstColumn, endColumn);
+        });
+        return;
+    }
+
+    energyMap.reshape(imageMap.rows, imageMap.columns);
+    pool.runRange(0, imageMap.rows, [&](int firstRow, int endRow)
+    {
+        energyRows(imageMap, energyMap, firstRow, endRow);
+    });
 }
 
-/// @brief A 2D vector of integers is populated with pixel energy values using an image map produced by initImageMap.
-/// @param imageMap A 2D vector containing the pixel data of a pgm file
-/// @return The resultant energy map by value.
-vector<vector<int>> initEnergyMap(const vector<vector<int>> &imageMap)
+/// @brief The rows [firstRow, endRow) of the energy map of an image map, see initEnergyMap.
+template <typename Pixel>
+void energyRows(const Image<Pixel> &imageMap, Image<int> &energyMap, int firstRow, int endRow)
 {
-    vector<vector<int>> result;
-    for (int i = 0; i < imageMap.size(); ++i)
+    for (int i = firstRow; i < endRow; ++i)
     {
         // outer-for iterates over rows
 
-        vector<int> rowResult;
-        for (int j = 0; j < imageMap[i].size(); ++j) 
+        int *rowResult = energyMap.row(i);
+        if (i == 0 || i == imageMap.rows - 1 || imageMap.columns < 3)
         {
-            // inner-for iterates over individual pixels in each row
-            
-            // #REGION find ΔI along X axis 
-            // bounds checking X
-            int left = (j - 1) >= 0 ? imageMap[i][j - 1] : imageMap[i][j]; 
-            int right = (j + 1) < imageMap[i].size() ? imageMap[i][j + 1] : imageMap[i][j];
+            // the border rows (and images too narrow to have an interior) are done pixel by pixel
+            for (int j = 0; j < imageMap.columns; ++j) 
+            {
+                // inner-for iterates over individual pixels in each row, storing the energy of each
+                rowResult[j] = pixelEnergy(imageMap, i, j);
+            }
+            continue;
+        }
 
-            int changeX = abs(imageMap[i][j] - left) + abs(imageMap[i][j] - right);
-            // #ENDREGION
+        // the border columns pixel by pixel, everything between with the interior kernels
+        rowResult[0] = pixelEnergy(imageMap, i, 0);
+        energyRowInterior(imageMap.row(i - 1), imageMap.row(i), imageMap.row(i + 1), rowResult, 1, imageMap.columns - 1);
+        rowResult[imageMap.columns - 1] = pixelEnergy(imageMap, i, imageMap.columns - 1);
+    }
+}
+
+// side of the square tiles energyColumns works in
+const int ENERGY_TILE = 64;
+
+/// @brief The columns [firstColumn, endColumn) of the energy map of an image map, laid out as rows of energyMap for
+///        horizontal seams, see initEnergyMap.
+/// @note A column of the image is one pixel from every row, so the image is read in ENERGY_TILE x ENERGY_TILE tiles:
+///       each tile, with the ring of pixels around it, is copied into a small buffer one column to a row. Its
+///       energies are then those of the interior kernels run along the buffer rows, since the energy treats both
+///       axes alike, and go to consecutive entries of the energy map.
+template <typename Pixel>
+void energyColumns(const Image<Pixel> &imageMap, Image<int> &energyMap, int firstColumn, int endColumn)
+{
+    // tile[j - columnBegin + 1][i - rowBegin + 1] holds pixel (i, j)
+    Pixel tile[ENERGY_TILE + 2][ENERGY_TILE + 2];
+    int energies[ENERGY_TILE + 2];
+    int rows = imageMap.rows;
+    int columns = imageMap.columns;
+    for (int columnBegin = firstColumn; columnBegin < endColumn; columnBegin += ENERGY_TILE)
+    {
+        int columnEnd = std::min(columnBegin + ENERGY_TILE, endColumn);
+        for (int rowBegin = 0; rowBegin < rows; rowBegin += ENERGY_TILE)
+        {
+            int rowEnd = std::min(rowBegin + ENERGY_TILE, rows);
 
-            // #REGION find ΔI along Y axis 
-            // bounds checking Y
-            int up = (i - 1) >= 0 ? imageMap[i - 1][j] : imageMap[i][j];
-            int down = (i + 1) < imageMap.size() ? imageMap[i + 1][j] : imageMap[i][j];
+            // the tile and whatever of its ring lies within the image
+            for (int i = std::max(rowBegin - 1, 0); i < std::min(rowEnd + 1, rows); ++i)
+            {
+                const Pixel *pixels = imageMap.row(i);
+                for (int j = std::max(columnBegin - 1, 0); j < std::min(columnEnd + 1, columns); ++j)
+                {
+                    tile[j - columnBegin + 1][i - rowBegin + 1] = pixels[j];
+                }
+            }
 
-            int changeY = abs(imageMap[i][j] - up) + abs(imageMap[i][j] - down);
-            // #ENDREGION
-            
-            // store the energy of the pixel
-            rowResult.push_back(changeX + changeY);
+            // the rows of the tile with a row above and below
+            int interiorBegin = std::max(rowBegin, 1);
+            int interiorEnd = std::min(rowEnd, rows - 1);
+            for (int j = columnBegin; j < columnEnd; ++j)
+            {
+                int *columnResult = energyMap.row(j);
+                if (j == 0 || j == columns - 1 || interiorBegin >= interiorEnd)
+                {
+                    // the border columns (and tiles with no interior rows) are done pixel by pixel
+                    for (int i = rowBegin; i < rowEnd; ++i)
+                    {
+                        columnResult[i] = pixelEnergy(imageMap, i, j);
+                    }
+                    continue;
+                }
+
+                // the border rows pixel by pixel, everything between with the interior kernels
+                int t = j - columnBegin + 1;
+                energyRowInterior(tile[t - 1], tile[t], tile[t + 1], energies, interiorBegin - rowBegin + 1, interiorEnd - rowBegin + 1);
+                std::copy(energies + interiorBegin - rowBegin + 1, energies + interiorEnd - rowBegin + 1, columnResult + interiorBegin);
+                if (rowBegin == 0)
+                {
+                    columnResult[0] = pixelEnergy(imageMap, 0, j);
+                }
+                if (rowEnd == rows)
+                {
+                    columnResult[rows - 1] = pixelEnergy(imageMap, rows - 1, j);
+                }
+            }
+        }
+    }
+}
+
+/// @brief Carry the energy map of an image forward past the removal of a seam, instead of recomputing it.
+/// @param imageMap The image map the seam has just been carved out of.
+/// @param energyMap The energy map of imageMap before the seam was carved, laid out for the kind of seam carved
+///        (see initEnergyMap). The seam is removed from it as well.
+/// @param seam The seam as reported by seamCarver: for a vertical seam the column index of the removed pixel in
+///        each row, for a horizontal one the row index of the removed pixel in each column.
+/// @param horizontal Whether the seam was a horizontal one.
+/// @param pool The threads to share the rows (or columns) between.
+/// @note Only pixels that had a removed pixel (or a pixel shifted by it) as a neighbor change energy. In row i these
+///       lie within one column of the seam pixels of rows i - 1, i and i + 1, since a pixel's vertical neighbors only
+///       change where the seam shifted the rows above or below it differently than its own row. A horizontal seam
+///       is the same with rows and columns trading places.
+template <typename Pixel>
+void updateEnergyMap(const Image<Pixel> &imageMap, Image<int> &energyMap, const vector<int> &seam, bool horizontal, ThreadPool &pool)
+{
+    // remove the seam from the energy map just as it was removed from the image map. in the layout for horizontal
+    // seams (see initEnergyMap) that is one entry from each row as well
+    pool.runRange(0, energyMap.rows, [&](int firstRow, int endRow)
+    {
+        removeSeam(energyMap, seam, firstRow, endRow);
+    });
+    --energyMap.columns;
+
+    // the rows only read the image map, so they can be recomputed in any order
+    pool.runRange(0, energyMap.rows, [&](int firstRow, int endRow)
+    {
+        if (horizontal)
+        {
+            updateEnergyColumns(imageMap, energyMap, seam, firstRow, endRow);
+        }
+        else
+        {
+            updateEnergyRows(imageMap, energyMap, seam, firstRow, endRow);
+        }
+    });
+}
+
+/// @brief Recompute the energies around a vertical seam in the rows [firstRow, endRow), see updateEnergyMap.
+template <typename Pixel>
+void updateEnergyRows(const Image<Pixel> &imageMap, Image<int> &energyMap, const vector<int> &seam, int firstRow, int endRow)
+{
+    for (int i = firstRow; i < endRow; ++i)
+    {
+        // find the band of columns around the seam in this row and its neighbors
+        int first = seam[i];
+        int last = seam[i];
+        if (i - 1 >= 0)
+        {
+            first = std::min(first, seam[i - 1]);
+            last = std::max(last, seam[i - 1]);
+        }
+        if (i + 1 < imageMap.rows)
+        {
+            first = std::min(first, seam[i + 1]);
+            last = std::max(last, seam[i + 1]);
+        }
+
+        // recompute the energy of the band, widened by the left neighbor of the leftmost seam pixel
+        first = std::max(first - 1, 0);
+        last = std::min(last, imageMap.columns - 1);
+        int *rowResult = energyMap.row(i);
+        for (int j = first; j <= last; ++j)
+        {
+            rowResult[j] = pixelEnergy(imageMap, i, j);
+        }
+    }
+}
+
+/// @brief Recompute the energies around a horizontal seam in the columns [firstColumn, endColumn) of the image map,
+///        the rows of an energy map laid out for horizontal seams, see updateEnergyMap.
+template <typename Pixel>
+void updateEnergyColumns(const Image<Pixel> &imageMap, Image<int> &energyMap, const vector<int> &seam, int firstColumn, int endColumn)
+{
+    for (int j = firstColumn; j < endColumn; ++j)
+    {
+        // find the band of rows around the seam in this column and its neighbors
+        int first = seam[j];
+        int last = seam[j];
+        if (j - 1 >= 0)
+        {
+            first = std::min(first, seam[j - 1]);
+            last = std::max(last, seam[j - 1]);
+        }
+        if (j + 1 < imageMap.columns)
+        {
+            first = std::min(first, seam[j + 1]);
+            last = std::max(last, seam[j + 1]);
+        }
+
+        // recompute the energy of the band, widened by the upper neighbor of the topmost seam pixel
+        first = std::max(first - 1, 0);
+        last = std::min(last, imageMap.rows - 1);
+        int *columnResult = energyMap.row(j);
+        for (int i = first; i <= last; ++i)
+        {
+            columnResult[i] = pixelEnergy(imageMap, i, j);
         }
+    }
+}
+
+// narrowest tile the cumulative energy map is split into between threads (see initCumulativeEnergyMap)
+const int CE_MIN_TILE_WIDTH = 64;
+
+// #REGION cumulative energy kernels
+// each pixel's cumulative energy is its own plus the lowest of the (up to) three above it, and its backpointer
+// records which of them that was: -1 upper-left, 0 upper, +1 upper-right. ties go to the leftmost candidate,
+// the one the trace-back has always picked. as with the energy kernels, the vector kernels fill the columns
+// [begin, end) of a row (all three parents exist there) in whole vectors and return where they stopped.
+
+/// @brief Cumulative energy and backpointer of column j of a row, from the cumulative energies of the row above.
+inline void cumulativeEnergyPixel(const int *previous, const int *energy, int *result, int8_t *backpointers, int j, int columns)
+{
+    // upper, then upper-right only if strictly lower, then upper-left if no higher
+    int best = previous[j];
+    int8_t direction = 0;
+    if ((j + 1) < columns && previous[j + 1] < best)
+    {
+        best = previous[j + 1];
+        direction = 1;
+    }
+    if ((j - 1) >= 0 && previous[j - 1] <= best)
+    {
+        best = previous[j - 1];
+        direction = -1;
+    }
+
+    result[j] = energy[j] + best;
+    backpointers[j] = direction;
+}
+
+#ifdef SEAM_HAVE_X86_SIMD
+
+/// @brief SSE2 kernel: 8 pixels per step. SSE2 has no 32-bit min, so it is built from a compare and masks.
+inline int cumulativeEnergyRowSse2(const int *previous, const int *energy, int *result, int8_t *backpointers, int begin, int end)
+{
+    int j = begin;
+    for (; j + 8 <= end; j += 8)
+    {
+        __m128i directions[2];
+        for (int half = 0; half < 2; ++half)
+        {
+            int k = j + 4 * half;
+            __m128i left = _mm_loadu_si128((const __m128i *) (previous + k - 1));
+            __m128i upper = _mm_loadu_si128((const __m128i *) (previous + k));
+            __m128i right = _mm_loadu_si128((const __m128i *) (previous + k + 1));
+
+            // lanes are all ones where the right candidate beats the upper one and where the left beats both
+            __m128i rightWins = _mm_cmpgt_epi32(upper, right);
+            __m128i best = _mm_or_si128(_mm_and_si128(rightWins, right), _mm_andnot_si128(rightWins, upper));
+            __m128i leftWins = _mm_andnot_si128(_mm_cmpgt_epi32(left, best), _mm_set1_epi32(-1));
+            best = _mm_or_si128(_mm_and_si128(leftWins, left), _mm_andnot_si128(leftWins, best));
+
+            _mm_storeu_si128((__m128i *) (result + k), _mm_add_epi32(_mm_loadu_si128((const __m128i *) (energy + k)), best));
+
+            // all ones is -1, so the direction is -1 where left wins, else 1 where right wins, else 0
+            directions[half] = _mm_or_si128(leftWins, _mm_andnot_si128(leftWins, _mm_sub_epi32(_mm_setzero_si128(), rightWins)));
+        }
+
+        // narrow the 8 directions to bytes
+        __m128i packed = _mm_packs_epi32(directions[0], directions[1]);
+        _mm_storel_epi64((__m128i *) (backpointers + j), _mm_packs_epi16(packed, packed));
+    }
+    return j;
+}
+
+/// @brief AVX2 kernel: 8 pixels per step with native 32-bit min and blends.
+__attribute__((target("avx2"))) inline int cumulativeEnergyRowAvx2(const int *previous, const int *energy, int *result, int8_t *backpointers,
+                                                                   int begin, int end)
+{
+    int j = begin;
+    for (; j + 8 <= end; j += 8)
+    {
+        __m256i left = _mm256_loadu_si256((const __m256i *) (previous + j - 1));
+        __m256i upper = _mm256_loadu_si256((const __m256i *) (previous + j));
+        __m256i right = _mm256_loadu_si256((const __m256i *) (previous + j + 1));
+
+        __m256i rightWins = _mm256_cmpgt_epi32(upper, right);
+        __m256i best = _mm256_min_epi32(upper, right);
+        __m256i leftLoses = _mm256_cmpgt_epi32(left, best);
+        best = _mm256_min_epi32(left, best);
+
+        _mm256_storeu_si256((__m256i *) (result + j), _mm256_add_epi32(_mm256_loadu_si256((const __m256i *) (energy + j)), best));
 
-        result.push_back(rowResult);
+        // -1 where left wins, else 1 where right wins, else 0
+        __m256i direction = _mm256_blendv_epi8(_mm256_set1_epi32(-1), _mm256_sub_epi32(_mm256_setzero_si256(), rightWins), leftLoses);
+        __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(direction), _mm256_extracti128_si256(direction, 1));
+        _mm_storel_epi64((__m128i *) (backpointers + j), _mm_packs_epi16(packed, packed));
     }
-    
-    return result;
+    return j;
 }
 
-/// @brief A 2D vector of integers is populated with cumulative energy values using an energy matrix.
+#endif
+
+/// @brief Cumulative energies and backpointers of the columns [begin, end) of a row, with the widest kernel
+///        available for the interior.
+inline void cumulativeEnergyRow(const int *previous, const int *energy, int *result, int8_t *backpointers, int begin, int end, int columns)
+{
+    if (begin >= end)
+    {
+        return;
+    }
+
+    // the first and last column have only two parents and are done by the scalar step
+    int interiorBegin = std::max(begin, 1);
+    int interiorEnd = std::min(end, columns - 1);
+    if (begin == 0)
+    {
+        cumulativeEnergyPixel(previous, energy, result, backpointers, 0, columns);
+    }
+
+    int j = interiorBegin;
+#ifdef SEAM_HAVE_X86_SIMD
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2 && j < interiorEnd)
+    {
+        j = cumulativeEnergyRowAvx2(previous, energy, result, backpointers, j, interiorEnd);
+    }
+    if (j < interiorEnd)
+    {
+        j = cumulativeEnergyRowSse2(previous, energy, result, backpointers, j, interiorEnd);
+    }
+#endif
+    for (; j < interiorEnd; ++j)
+    {
+        cumulativeEnergyPixel(previous, energy, result, backpointers, j, columns);
+    }
+
+    if (end == columns && columns > 1)
+    {
+        cumulativeEnergyPixel(previous, energy, result, backpointers, columns - 1, columns);
+    }
+}
+// #ENDREGION
+
+/// @brief A cumulative energy map is populated with cumulative energy values using an energy map.
 /// @param energyMap The energy map which is used to derive the CE map.
-/// @return The resultant cumulative energy map by value.
+/// @param cumulativeEnergyMap The resultant cumulative energy map, reshaped to the dimensions of energyMap.
+/// @param backpointers Receives, for every pixel below the first row, the column offset (-1, 0 or +1) of the
+///        pixel above it that its cumulative energy came from, so the seam can be traced back without searching.
+/// @param pool The threads to share the map between, see the note on tiling in the body.
 /// @note The lowest energy value in the final row of a CE matrix represents the pixel 
 ///       which ends the lowest energy seam.
-vector<vector<int>> initCumulativeEnergyMap(const vector<vector<int>> &energyMap)
+void initCumulativeEnergyMap(const Image<int> &energyMap, Image<int> &cumulativeEnergyMap, Image<int8_t> &backpointers, ThreadPool &pool)
 {
-    // initialize result with the contents of the energyMap
-    vector<vector<int>> result (energyMap);
+    Image<int> &result = cumulativeEnergyMap;
+    result.reshape(energyMap.rows, energyMap.columns);
+    backpointers.reshape(energyMap.rows, energyMap.columns);
+
+    // the first row is the first row of the energyMap
+    std::copy(energyMap.row(0), energyMap.row(0) + energyMap.columns, result.row(0));
 
     /*  objective: for each pixel, act as though this is the end of the seam.
                    write to result at this indexed pixel, the "cumulative energy"
@@ -331,191 +1110,519 @@ vector<vector<int>> initCumulativeEnergyMap(const vector<vector<int>> &energyMap
         +---+---+---+---+
 
         from the perspective of X, we are looking at ... 
-            energyMap[i - 1][j - 1], energyMap[i - 1][j], and energyMap[i - 1][j + 1]
+            result(i - 1, j - 1), result(i - 1, j), and result(i - 1, j + 1)
         
-        bounds checking will need to be done on j
+        bounds checking is only needed in the first and last column, see cumulativeEnergyRow
     */
 
-    for (int i = 1; i < result.size(); ++i)
+    // one thread, or too narrow to be worth splitting: row after row
+    int columns = result.columns;
+    int tileWidth = std::max(CE_MIN_TILE_WIDTH, (columns + pool.size() - 1) / pool.size());
+    if (pool.size() == 1 || columns < 2 * tileWidth)
     {
-        // outer-for iterates over rows (begin iterating on second row)
-
-        for (int j = 0; j < result[i].size(); ++j) 
+        for (int i = 1; i < result.rows; ++i)
         {
-            // inner-for iterates over individual pixels in each row
-            
-            //#REGION bounds checking
-            // create a list of up to 3 (or 2) seam origin pixels in the row above that can be connected
-            // to the seam pixel in the current row.
-            vector<int> nextSeamPixelCandidates;
+            // iterate over rows (begin iterating on second row), each computed from the one above
+            cumulativeEnergyRow(result.row(i - 1), energyMap.row(i), result.row(i), backpointers.row(i), 0, columns, columns);
+        }
+        return;
+    }
 
-            // validate bounds of upper-left
-            if ((j - 1) >= 0) 
-            { 
-                nextSeamPixelCandidates.push_back(result[i - 1][j - 1]);
-            }
+    /*  tiling: a row depends on the whole row above it, but a pixel only on the three above it. the columns are
+        cut into tiles of tileWidth, the rows into bands of bandHeight = tileWidth / 2, and each band is done in two
+        steps with all threads. first every tile computes the rows of the band, narrowing by one column on each side
+        per row so it only ever needs pixels it computed itself (an upside-down trapezoid). then the triangles left
+        between neighboring tiles are filled in, each from the trapezoids on either side of it and its own rows.
+
+            row 0   |TTTTTTTTTTTT|TTTTTTTTTTTT|
+            row 1   |TTTTTTTTTTT.|.TTTTTTTTTT.|     T  first step, one task per tile
+            row 2   |TTTTTTTTTT..|..TTTTTTTT..|     .  second step, one task per boundary between tiles
+            row 3   |TTTTTTTTT...|...TTTTTT...|
 
-            // no need to validate upper
-            nextSeamPixelCandidates.push_back(result[i - 1][j]);
+        the image border needs no narrowing, so the first and last tile keep their outer edge.
+    */
+    int tiles = (columns + tileWidth - 1) / tileWidth;
+    int bandHeight = tileWidth / 2;
+    for (int bandBegin = 1; bandBegin < result.rows; bandBegin += bandHeight)
+    {
+        int bandEnd = std::min(result.rows, bandBegin + bandHeight);
 
-            // validate bounds of upper-right
-            if ((j + 1) < energyMap[i].size()) 
-            { 
-                nextSeamPixelCandidates.push_back(result[i - 1][j + 1]);
+        pool.run(tiles, [&](int tile)
+        {
+            for (int i = bandBegin; i < bandEnd; ++i)
+            {
+                int narrowing = i - bandBegin;
+                int begin = tile == 0 ? 0 : tile * tileWidth + narrowing;
+                int end = tile == tiles - 1 ? columns : (tile + 1) * tileWidth - narrowing;
+                cumulativeEnergyRow(result.row(i - 1), energyMap.row(i), result.row(i), backpointers.row(i), begin, std::min(end, columns), columns);
             }
-            //#ENDREGION
+        });
 
-            // at this pixel, add to its energy the minimum energy contained within nextSeamPixelCandidates
-            result[i][j] += *std::min_element(nextSeamPixelCandidates.begin(), nextSeamPixelCandidates.end());
-        }
+        pool.run(tiles - 1, [&](int boundary)
+        {
+            int edge = (boundary + 1) * tileWidth;
+            for (int i = bandBegin; i < bandEnd; ++i)
+            {
+                int narrowing = i - bandBegin;
+                cumulativeEnergyRow(result.row(i - 1), energyMap.row(i), result.row(i), backpointers.row(i), edge - narrowing,
+                                    std::min(edge + narrowing, columns), columns);
+            }
+        });
     }
-
-    return result;
 }
 
 /// @brief Given the image map and its cumulative energy map, "carve out" the lowest energy seam 
 ///        from the image map.
 /// @param imageMap The image map to be modified by the seamCarver.
-/// @param cumulativeEnergyMap The CE map to be traced-back to determine the lowest energy seam.
-void seamCarver(vector<vector<int>> &imageMap, const vector<vector<int>> &cumulativeEnergyMap)
+/// @param cumulativeEnergyMap The CE map whose final row determines where the lowest energy seam ends.
+/// @param backpointers The backpointers written by initCumulativeEnergyMap, followed to trace the seam back.
+/// @param horizontal Whether the maps were built for a horizontal seam (see initCumulativeEnergyMap).
+/// @param seam_indices Receives the column index of the removed pixel in each row, or for a horizontal seam the
+///        row index of the removed pixel in each column.
+/// @param pool The threads to share the rows (or columns) between.
+template <typename Pixel>
+void seamCarver(Image<Pixel> &imageMap, const Image<int> &cumulativeEnergyMap, const Image<int8_t> &backpointers, bool horizontal,
+                vector<int> &seam_indices, ThreadPool &pool)
 {
     // modify imageMap by identifying the pixel in each row that is an element of the 
-    // lowest energy seam, shifting it the end of the row, and popping back that element to carve out the seam
+    // lowest energy seam, and closing the gap it leaves in each row to carve out the seam
 
-    // each element of seam_column_indices corresponds to a row in the image map, 
-    // and contains the column index of the seam pixel in that row.
-    int seam_column_indices[cumulativeEnergyMap.size()] = { -1 }; 
+    // each element of seam_indices corresponds to a row of the CE map (a row of the image map, or a column
+    // for a horizontal seam), and contains the index of the seam pixel in it.
+    seam_indices.assign(cumulativeEnergyMap.rows, -1); 
 
     // get the index of the seam-ending pixel and put at the end of the seam pixel list
     // the seam-ending pixel is the element in the final row of the cumulativeEnergyMap with the lowest energy
-    int num_rows = cumulativeEnergyMap.size();                                                                                
-    auto seam_end_itr = std::min_element(cumulativeEnergyMap[num_rows - 1].begin(), cumulativeEnergyMap[num_rows - 1].end()); 
-    int seam_end_index = std::distance(cumulativeEnergyMap[num_rows - 1].begin(), seam_end_itr);                              
-    seam_column_indices[num_rows - 1] = seam_end_index;
-
-    // iterate in reverse-row order, descending the seam
-    // for each iteration, first remove the seam pixel for that row 
-    // and next trace-back the seam to find the index of the seam pixel connected to it for the next iteration
-    for (int i = cumulativeEnergyMap.size() - 1; i >= 0; --i)
-    {
-        //#REGION remove the seam_pixel for this row
-        // Remove the seam pixel from the current row by swapping it with adjacent pixels
-        // until it reaches the end of the row, and then "snipping" it off from the end.
-        int seam_pixel_index = seam_column_indices[i];
-        while (seam_pixel_index + 1 < cumulativeEnergyMap[i].size())
-        {
-            // while-loop swaps the seam pixel until it is at the end of the row 
-            std::swap(imageMap[i][seam_pixel_index], imageMap[i][seam_pixel_index + 1]);
-            ++seam_pixel_index;
-        }
-        imageMap[i].pop_back();
-        //#ENDREGION
-        
-        //#REGION find out what the next seam pixel index is for the next iteration
-        if ((i - 1) >= 0)
+    int num_rows = cumulativeEnergyMap.rows;                                                                                
+    const int *last_row = cumulativeEnergyMap.row(num_rows - 1);
+    const int *seam_end_itr = std::min_element(last_row, last_row + cumulativeEnergyMap.columns); 
+    int seam_end_index = std::distance(last_row, seam_end_itr);                              
+    seam_indices[num_rows - 1] = seam_end_index;
+
+    // iterate in reverse-row order, tracing the seam back: the backpointer of each seam pixel 
+    // says which of the pixels above it the seam came from
+    for (int i = num_rows - 1; i > 0; --i)
+    {
+        seam_indices[i - 1] = seam_indices[i] + backpointers(i, seam_indices[i]);
+    }
+
+    if (horizontal)
+    {
+        // move the part of every column below its seam pixel up by one row; each thread sweeps its columns top to bottom
+        pool.runRange(0, imageMap.columns, [&](int firstColumn, int endColumn)
+        {
+            removeHorizontalSeam(imageMap, seam_indices, firstColumn, endColumn);
+        });
+        --imageMap.rows;
+        return;
+    }
+
+    // remove the seam pixel of every row by moving the rest of the row left over it, one memmove per row. 
+    // the rows stay where they are; only the logical width shrinks
+    pool.runRange(0, num_rows, [&](int firstRow, int endRow)
+    {
+        removeSeam(imageMap, seam_indices, firstRow, endRow);
+    });
+    --imageMap.columns;
+}
+
+/// @brief Trace up to count seams back from one cumulative energy map, none sharing a pixel with another.
+/// @param cumulativeEnergyMap The CE map; its final row decides the order in which seam ends are tried.
+/// @param backpointers The backpointers of the CE map, followed wherever the pixel they point to is still free.
+/// @param count Number of seams wanted.
+/// @param seams Receives the seams found, one after another: seam s runs from seams[s * rows] to seams[s * rows + rows - 1].
+/// @param taken Scratch map marking the pixels already claimed by a seam.
+/// @return Number of seams found, at least 1 and at most count.
+/// @note The greedy trace-back starts from the cheapest free pixels of the last row. Where the backpointer leads onto
+///       a pixel claimed by an earlier seam, or across one, it moves to the cheapest free pixel among the other two
+///       above instead; a seam with no way up is dropped. The first seam is the exact lowest energy seam, the others
+///       are only approximately the next lowest, since the map was computed before any of them was removed.
+int findSeamBatch(const Image<int> &cumulativeEnergyMap, const Image<int8_t> &backpointers, int count, vector<int> &seams, Image<uint8_t> &taken)
+{
+    int rows = cumulativeEnergyMap.rows;
+    int columns = cumulativeEnergyMap.columns;
+    taken.reshape(rows, columns);
+    for (int i = 0; i < rows; ++i)
+    {
+        std::fill(taken.row(i), taken.row(i) + columns, 0);
+    }
+
+    // seam ends in order of cumulative energy, leftmost first among equals
+    const int *last_row = cumulativeEnergyMap.row(rows - 1);
+    vector<int> ends(columns);
+    for (int j = 0; j < columns; ++j)
+    {
+        ends[j] = j;
+    }
+    std::stable_sort(ends.begin(), ends.end(), [&](int a, int b) { return last_row[a] < last_row[b]; });
+
+    seams.clear();
+    vector<int> path(rows);
+    int found = 0;
+    for (int e = 0; e < columns && found < count; ++e)
+    {
+        path[rows - 1] = ends[e];
+        if (taken(rows - 1, ends[e]))
         {
-            // if-block only reached if trace-back step doesn't take us out of bounds
+            continue;
+        }
 
-            //#REGION bounds checking
-            // create a candidate list of seam pixel indices
-            // that can connect to the seam pixel in the current row.
+        bool complete = true;
+        for (int i = rows - 1; i > 0 && complete; --i)
+        {
+            int j = path[i];
 
-            // declarations
-            vector<int> nextSeamPixelCandidates; 
-            int indexUpperLeft = seam_column_indices[i] - 1;
-            int indexUpper = seam_column_indices[i];
-            int indexUpperRight = seam_column_indices[i] + 1;
+            // a step up is allowed onto a free pixel that does not cross a claimed diagonal step
+            auto allowed = [&](int next)
+            {
+                if (next < 0 || next >= columns || taken(i - 1, next))
+                {
+                    return false;
+                }
+                return next == j || !(taken(i, next) && taken(i - 1, j));
+            };
+
+            int next = j + backpointers(i, j);
+            if (!allowed(next))
+            {
+                // fall back to the cheapest allowed pixel above, leftmost first among equals
+                next = -1;
+                for (int candidate = j - 1; candidate <= j + 1; ++candidate)
+                {
+                    if (allowed(candidate) && (next < 0 || cumulativeEnergyMap(i - 1, candidate) < cumulativeEnergyMap(i - 1, next)))
+                    {
+                        next = candidate;
+                    }
+                }
+                complete = next >= 0;
+            }
+            path[i - 1] = next;
+        }
 
-            // validate bounds of upper-left
-            bool upperLeftIsIncluded = false;
-            if ((indexUpperLeft) >= 0) 
-            { 
-                // the connecting seam pixel might be the upper-left pixel
-                nextSeamPixelCandidates.push_back(cumulativeEnergyMap[i - 1][indexUpperLeft]);
-                upperLeftIsIncluded = true;
+        if (complete)
+        {
+            // claim the pixels of the seam
+            for (int i = 0; i < rows; ++i)
+            {
+                taken(i, path[i]) = 1;
             }
+            seams.insert(seams.end(), path.begin(), path.end());
+            ++found;
+        }
+    }
 
-            // no need to validate upper as it will never be out of bounds
-            nextSeamPixelCandidates.push_back(cumulativeEnergyMap[i - 1][indexUpper]);
+    return found;
+}
 
-            // validate bounds of upper-right
-            bool upperRightIsIncluded = false;
-            if ((indexUpperRight) < cumulativeEnergyMap[i].size()) 
-            { 
-                // the connecting seam pixel might be the upper-right pixel
-                nextSeamPixelCandidates.push_back(cumulativeEnergyMap[i - 1][indexUpperRight]);
-                upperRightIsIncluded = true;
+/// @brief Carve num_seams seams out of the image map in batches: each energy and cumulative energy map yields up to
+///        batchSize seams (see findSeamBatch), which are then removed together.
+/// @param horizontal Whether to carve horizontal seams rather than vertical ones.
+template <typename Pixel>
+void carveSeamBatches(Image<Pixel> &imageMap, int num_seams, bool horizontal, int batchSize,
+                      Image<int> &E, Image<int> &CE, Image<int8_t> &B, ThreadPool &pool)
+{
+    const char *orientation = horizontal ? "[H[O][R][I][Z][O][N][T][A][L]" : "[V[E][R][T][I][C][A][L]";
+    vector<int> seams;
+    Image<uint8_t> taken;
+    int carved = 0;
+    while (carved < num_seams)
+    {
+        initEnergyMap(imageMap, E, horizontal, pool);
+        initCumulativeEnergyMap(E, CE, B, pool);
+
+        int found = findSeamBatch(CE, B, std::min(batchSize, num_seams - carved), seams, taken);
+        removeSeams(imageMap, seams, found, horizontal, pool);
+
+        for (int s = 0; s < found; ++s)
+        {
+            cout << "\n[C][A][R][V][I][N][G] " << orientation << " [S][E][A][M] [" << ++carved << "]\n";
+        }
+    }
+}
+
+/// @brief Carve num_vertical_seams vertical and num_horizontal_seams horizontal seams out of the image map in the order
+///        that removes the least energy overall, chosen with the transport map of Avidan and Shamir.
+/// @param imageMap The image map to carve; on return it holds the image reached by the optimal order.
+/// @param incrementalEnergy Carry the energy map along each row of the transport map instead of recomputing it.
+/// @param pool The threads to share the maps between.
+/// @return The order the seams were removed in, one letter per seam: 'V' vertical, 'H' horizontal.
+/// @note T(r, c), the least energy removed to take out r horizontal and c vertical seams, is the cheaper of
+///       T(r - 1, c) plus the lowest horizontal seam of that image and T(r, c - 1) plus the lowest vertical seam of
+///       that one. Every cell needs the image it stands for, but a row of T only depends on the row above, so the
+///       images are kept for one row: images[c] holds cell (r - 1, c) until cell (r, c) replaces it. The rows are
+///       laid along the smaller of the two seam counts (across a row of T go the horizontal seams when there are
+///       fewer of them), so min(num_vertical_seams, num_horizontal_seams) + 1 images are held at once, next to
+///       (num_vertical_seams + 1) * (num_horizontal_seams + 1) cells each costing up to two cumulative energy maps.
+///       Along a row, the energy map of images[c - 1] is carried over to images[c] whenever the cell was reached
+///       across the row, so only the candidates from the row above need a full energy map. Since each cell only
+///       keeps the image of its cheapest path, the order found can on occasion remove slightly more energy than the
+///       default one.
+template <typename Pixel>
+string carveInOptimalOrder(Image<Pixel> &imageMap, int num_vertical_seams, int num_horizontal_seams, bool incrementalEnergy, ThreadPool &pool)
+{
+    // the seams across a row of T, and those down a column
+    bool acrossIsHorizontal = num_horizontal_seams < num_vertical_seams;
+    int across = acrossIsHorizontal ? num_horizontal_seams : num_vertical_seams;
+    int down = acrossIsHorizontal ? num_vertical_seams : num_horizontal_seams;
+
+    int width = across + 1;
+    vector<Image<Pixel>> images(width);
+    vector<long long> removedEnergy(width); // T of the cells held in images
+    vector<uint8_t> cameAcross((size_t) (down + 1) * width);
+
+    Image<int> E, CE, downE, downCE;
+    Image<int8_t> B, downB;
+    vector<int> seam;
+
+    std::swap(images[0], imageMap);
+    removedEnergy[0] = 0;
+    for (int r = 0; r <= down; ++r)
+    {
+        cout << "\n[T][R][A][N][S][P][O][R][T] [M][A][P] [R][O][W] [" << r << "]\n";
+
+        bool energyIsCurrent = false; // whether E is the energy map of images[c - 1]
+        for (int c = 0; c <= across; ++c)
+        {
+            if (r == 0 && c == 0)
+            {
+                continue;
             }
 
-            // among the candidate seam pixels, find the one with the lowest energy
-            int seam_traceback_value = *std::min_element(nextSeamPixelCandidates.begin(), nextSeamPixelCandidates.end()); 
-            
-            // find the index in the trace-back row of this "lowest energy" pixel.
-            // we need to define a range for out search. start by assuming it includes all three candidate indices
-            int offsetStart = indexUpperLeft;
-            int offsetEnd = indexUpperRight;
-            if (!upperLeftIsIncluded)
+            // the lowest seam across from cell (r, c - 1)
+            long long acrossEnergy = LLONG_MAX;
+            if (c > 0)
             {
-                // if no upper-left, we are on a left boundary. constrain start of range
-                offsetStart = indexUpper;
+                if (!energyIsCurrent)
+                {
+                    initEnergyMap(images[c - 1], E, acrossIsHorizontal, pool);
+                }
+                initCumulativeEnergyMap(E, CE, B, pool);
+                const int *last_row = CE.row(CE.rows - 1);
+                acrossEnergy = removedEnergy[c - 1] + *std::min_element(last_row, last_row + CE.columns);
             }
-            
-            if (!upperRightIsIncluded)
+
+            // the lowest seam down from cell (r - 1, c)
+            long long downEnergy = LLONG_MAX;
+            if (r > 0)
             {
-                // if no upper-right, we're on a right boundary. constrain end of range
-                offsetEnd = indexUpper;
+                initEnergyMap(images[c], downE, !acrossIsHorizontal, pool);
+                initCumulativeEnergyMap(downE, downCE, downB, pool);
+                const int *last_row = downCE.row(downCE.rows - 1);
+                downEnergy = removedEnergy[c] + *std::min_element(last_row, last_row + downCE.columns);
             }
-            //#ENDREGION
-            
-            // with the defined range to search across, look for the index of the next seam pixel
-            auto seam_traceback_itr = std::find(cumulativeEnergyMap[i - 1].begin() + offsetStart, cumulativeEnergyMap[i - 1].begin() + offsetEnd, seam_traceback_value);
-            int seam_traceback_index = std::distance(cumulativeEnergyMap[i - 1].begin(), seam_traceback_itr);
 
-            // finally, assign this index as the next iterations seam pixel index
-            seam_column_indices[i - 1] = seam_traceback_index;
-        //#ENDREGION
+            // ties go to the vertical seam
+            if (acrossEnergy < downEnergy || (acrossEnergy == downEnergy && !acrossIsHorizontal))
+            {
+                images[c] = images[c - 1];
+                seamCarver(images[c], CE, B, acrossIsHorizontal, seam, pool);
+                if (incrementalEnergy)
+                {
+                    updateEnergyMap(images[c], E, seam, acrossIsHorizontal, pool);
+                }
+                energyIsCurrent = incrementalEnergy;
+                removedEnergy[c] = acrossEnergy;
+                cameAcross[(size_t) r * width + c] = 1;
+            }
+            else
+            {
+                seamCarver(images[c], downCE, downB, !acrossIsHorizontal, seam, pool);
+                energyIsCurrent = false;
+                removedEnergy[c] = downEnergy;
+            }
         }
     }
+
+    // walk the choices back from the last cell
+    string order;
+    for (int r = down, c = across; r > 0 || c > 0;)
+    {
+        if (cameAcross[(size_t) r * width + c])
+        {
+            order += acrossIsHorizontal ? 'H' : 'V';
+            --c;
+        }
+        else
+        {
+            order += acrossIsHorizontal ? 'V' : 'H';
+            --r;
+        }
+    }
+    std::reverse(order.begin(), order.end());
+
+    std::swap(imageMap, images[across]);
+    cout << "\nEnergy removed: " << removedEnergy[across] << "\n";
+    return order;
+}
+
+/// @brief Remove several seams from a map in one pass over each row, every kept pixel moving once.
+/// @param map The map to remove the seams from. Its logical width shrinks by count, or its height for horizontal seams.
+/// @param seams count seams laid out as findSeamBatch leaves them; no two share a pixel.
+/// @param horizontal Whether the seams are horizontal ones, holding a row index for each column.
+/// @param pool The threads to share the rows (or columns) between.
+template <typename T>
+void removeSeams(Image<T> &map, const vector<int> &seams, int count, bool horizontal, ThreadPool &pool)
+{
+    if (horizontal)
+    {
+        pool.runRange(0, map.columns, [&](int firstColumn, int endColumn)
+        {
+            removeHorizontalSeams(map, seams, count, firstColumn, endColumn);
+        });
+        map.rows -= count;
+        return;
+    }
+
+    pool.runRange(0, map.rows, [&](int firstRow, int endRow)
+    {
+        vector<int> removed(count);
+        for (int i = firstRow; i < endRow; ++i)
+        {
+            for (int s = 0; s < count; ++s)
+            {
+                removed[s] = seams[(size_t) s * map.rows + i];
+            }
+            std::sort(removed.begin(), removed.end());
+
+            // slide each run of kept pixels left past the pixels removed before it
+            T *row = map.row(i);
+            for (int s = 0; s < count; ++s)
+            {
+                int runEnd = s + 1 < count ? removed[s + 1] : map.columns;
+                std::memmove(row + removed[s] - s, row + removed[s] + 1, (runEnd - removed[s] - 1) * sizeof(T));
+            }
+        }
+    });
+    map.columns -= count;
 }
 
-/// @brief Transpose a given 2D vector.
-/// @param imageMap 2D vector to transpose. Original is modified.
-void transposeMap(vector<vector<int>> &imageMap)
+/// @brief Remove count horizontal seams from the columns [firstColumn, endColumn) of a map, see removeSeams. Its
+///        height is left alone for the caller to shrink.
+template <typename T>
+void removeHorizontalSeams(Image<T> &map, const vector<int> &seams, int count, int firstColumn, int endColumn)
 {
-    // the transpose map will need as many rows as imageMap has columns
-    vector<vector<int>> transpose(imageMap[0].size(), vector<int>());
+    if (firstColumn >= endColumn)
+    {
+        return;
+    }
 
-    for(int i = 0; i < imageMap.size(); ++i)
+    // the removed rows of each column, in order
+    int width = endColumn - firstColumn;
+    vector<int> removed((size_t) width * count);
+    for (int j = firstColumn; j < endColumn; ++j)
     {
-        for(int j = 0; j < imageMap[i].size(); ++j)
-        {   
-            // for each pixel in this row of imageMap,
-            // push into consecutive rows of the transpose
+        int *columnRemoved = &removed[(size_t) (j - firstColumn) * count];
+        for (int s = 0; s < count; ++s)
+        {
+            columnRemoved[s] = seams[(size_t) s * map.columns + j];
+        }
+        std::sort(columnRemoved, columnRemoved + count);
+    }
 
-            // Ex)   
-            // row: [1 2 3] of imageMap becomes 
-            // 
-            // column: [1]
-            //         [2]
-            //         [3]
- 
-            transpose[j].push_back(imageMap[i][j]);
+    // fill the rows top to bottom, each pixel from the first row below it not yet used or removed. passed[j] counts the
+    // removed rows of column j above that source row; rows are only ever read from below the row being written
+    vector<int> passed(width, 0);
+    int top = *std::min_element(removed.begin(), removed.end());
+    for (int i = top; i < map.rows - count; ++i)
+    {
+        T *row = map.row(i);
+        for (int j = firstColumn; j < endColumn; ++j)
+        {
+            const int *columnRemoved = &removed[(size_t) (j - firstColumn) * count];
+            int &k = passed[j - firstColumn];
+            while (k < count && columnRemoved[k] <= i + k)
+            {
+                ++k;
+            }
+            if (k > 0)
+            {
+                row[j] = map(i + k, j);
+            }
         }
     }
+}
 
-    imageMap = transpose;
+/// @brief Remove one pixel from each of the rows [firstRow, endRow) of a map, moving the rest of the row left over it
+///        with one memmove.
+/// @param map The map to remove the seam from. Its logical width is left alone, so the caller can split the
+///        rows between threads and shrink it by one once all of them are done.
+/// @param seam The column index of the pixel to remove in each row.
+template <typename T>
+void removeSeam(Image<T> &map, const vector<int> &seam, int firstRow, int endRow)
+{
+    for (int i = firstRow; i < endRow; ++i)
+    {
+        T *row = map.row(i);
+        std::memmove(row + seam[i], row + seam[i] + 1, (map.columns - seam[i] - 1) * sizeof(T));
+    }
+}
 
-    return;
+// columns removeHorizontalSeam moves together; below the lowest seam pixel among them, a row of the chunk is one memcpy
+const int SEAM_COLUMN_CHUNK = 64;
+
+/// @brief Remove one pixel from each of the columns [firstColumn, endColumn) of a map, moving the rest of the column up
+///        over it. Its height is left alone, as removeSeam leaves the width.
+/// @param seam The row index of the pixel to remove in each column.
+/// @note The columns are not contiguous, so rather than walking down each one the rows are swept top to bottom, every
+///       row taking the pixels of the row below wherever the seam lies at or above it; each row is read before it is
+///       overwritten. The columns go in chunks of SEAM_COLUMN_CHUNK: a row above every seam pixel of a chunk is left
+///       alone, a row below all of them is copied up whole, and only the rows between are done pixel by pixel.
+template <typename T>
+void removeHorizontalSeam(Image<T> &map, const vector<int> &seam, int firstColumn, int endColumn)
+{
+    if (firstColumn >= endColumn)
+    {
+        return;
+    }
+
+    // the highest and lowest seam pixel of each chunk
+    int chunks = (endColumn - firstColumn + SEAM_COLUMN_CHUNK - 1) / SEAM_COLUMN_CHUNK;
+    vector<int> chunkTop(chunks), chunkBottom(chunks);
+    for (int k = 0; k < chunks; ++k)
+    {
+        int begin = firstColumn + k * SEAM_COLUMN_CHUNK;
+        int end = std::min(begin + SEAM_COLUMN_CHUNK, endColumn);
+        chunkTop[k] = *std::min_element(seam.begin() + begin, seam.begin() + end);
+        chunkBottom[k] = *std::max_element(seam.begin() + begin, seam.begin() + end);
+    }
+
+    int top = *std::min_element(chunkTop.begin(), chunkTop.end());
+    for (int i = top; i + 1 < map.rows; ++i)
+    {
+        T *row = map.row(i);
+        const T *below = map.row(i + 1);
+        for (int k = 0; k < chunks; ++k)
+        {
+            int begin = firstColumn + k * SEAM_COLUMN_CHUNK;
+            int end = std::min(begin + SEAM_COLUMN_CHUNK, endColumn);
+            if (i >= chunkBottom[k])
+            {
+                std::memcpy(row + begin, below + begin, (end - begin) * sizeof(T));
+            }
+            else if (i >= chunkTop[k])
+            {
+                for (int j = begin; j < end; ++j)
+                {
+                    if (i >= seam[j])
+                    {
+                        row[j] = below[j];
+                    }
+                }
+            }
+        }
+    }
 }
 
-/// @brief Display a 2D vector.
-/// @param map The 2D vector to be displayed. 
-void displayMap(const vector<vector<int>> &map)
+/// @brief Display an image map.
+/// @param map The image map to be displayed. 
+template <typename T>
+void displayMap(const Image<T> &map)
 {
-    for (const vector<int>& row : map)
+    for (int i = 0; i < map.rows; ++i)
     {
-        for (int pixel : row)
+        for (int j = 0; j < map.columns; ++j)
         {
+            int pixel = map(i, j);
             if (pixel < 10)
             {
                 cout << "  000" << pixel;
@@ -539,25 +1646,31 @@ void displayMap(const vector<vector<int>> &map)
     return;
 }
 
-/// @brief Helper. Utilize existing functions to display the transpose of a map 
-///        without modifying the original.
-/// @param map The 2D vector whose transpose is to be displayed.
-void displayTranspose(const vector<vector<int>> &map)
+/// @brief Helper. Display the transpose of a map without modifying the original, such as the energy maps
+///        laid out for horizontal seams.
+/// @param map The map whose transpose is to be displayed.
+template <typename T>
+void displayTranspose(const Image<T> &map)
 {
-    vector<vector<int>> temp(map);
-
-    // transposes the temporary copy and displays it
-    transposeMap(temp);
+    // copies the map into a temporary transpose and displays it
+    Image<T> temp(map.columns, map.rows);
+    for (int i = 0; i < map.rows; ++i)
+    {
+        for (int j = 0; j < map.columns; ++j)
+        {
+            temp(j, i) = map(i, j);
+        }
+    }
     displayMap(temp);
 
     return;
 }
 
 /// @brief Validate command-line args for the number of seams to remove are within the acceptable range.
-/// @param imageMap The image map for which the seam carving requests are to be completed on.
-/// @param num_vertical_seams Number of vertical seams to remove. If outside range [0, imageMap(num_columns) - 1], the request is invalid.
-/// @param num_horizontal_seams Number of horizontal seams to remove. If outside range [0, imageMap(num_rows) - 1], the request is invalid.
-void validateCarveRequests(const vector<vector<int>> &imageMap, int num_vertical_seams, int num_horizontal_seams)
+/// @param header The header of the image for which the seam carving requests are to be completed on.
+/// @param num_vertical_seams Number of vertical seams to remove. If outside range [0, header.columns - 1], the request is invalid.
+/// @param num_horizontal_seams Number of horizontal seams to remove. If outside range [0, header.rows - 1], the request is invalid.
+void validateCarveRequests(const PgmHeader &header, int num_vertical_seams, int num_horizontal_seams)
 {
     // validate vertical seam request
     if (num_vertical_seams < 0)
@@ -565,10 +1678,10 @@ void validateCarveRequests(const vector<vector<int>> &imageMap, int num_vertical
         cerr << "error: requested number of vertical seams to carve must be greater than or equal to 0\n";
         exit(1);
     }
-    if (num_vertical_seams >= imageMap[0].size())
+    if (num_vertical_seams >= header.columns)
     {
         cerr << "error: the requested number of vertical seams to carve is " << num_vertical_seams << ", which is invalid.\n"
-             << "the provided image is " << imageMap[0].size() << " pixels wide. to carve the requested number of vertical seams would be to\n"
+             << "the provided image is " << header.columns << " pixels wide. to carve the requested number of vertical seams would be to\n"
              << "erase the image entirely\n";
         exit(1);
     }
@@ -579,10 +1692,10 @@ void validateCarveRequests(const vector<vector<int>> &imageMap, int num_vertical
         cerr << "error: requested number of horizontal seams to carve must be greater than or equal to 0\n";
         exit(1);
     }
-    if (num_horizontal_seams >= imageMap.size())
+    if (num_horizontal_seams >= header.rows)
     {
         cerr << "error: the requested number of horizontal seams to carve is " << num_horizontal_seams << ", which is invalid.\n"
-             << "the provided image is " << imageMap.size() << " pixels tall. to carve the requested number of horizontal seams would be to\n"
+             << "the provided image is " << header.rows << " pixels tall. to carve the requested number of horizontal seams would be to\n"
              << "erase the image entirely\n";
         exit(1);
     }
@@ -590,40 +1703,145 @@ void validateCarveRequests(const vector<vector<int>> &imageMap, int num_vertical
     return;
 }
 
+/// @brief Read the optional flags following the seam counts on the command line.
+/// @param argc Argument count passed to main.
+/// @param argv Arguments passed to main; flags start at argv[4].
+/// @return The carving options, defaults for anything not given.
+CarveOptions parseCarveOptions(int argc, char* argv[])
+{
+    CarveOptions options;
+    for (int i = 4; i < argc; ++i)
+    {
+        string flag = argv[i];
+        if (flag == "--full-energy")
+        {
+            // recompute the whole energy map for every seam
+            options.incrementalEnergy = false;
+        }
+        else if (flag == "--optimal-order")
+        {
+            // choose the order of vertical and horizontal seams by the transport map
+            options.optimalOrder = true;
+        }
+        else if (flag.compare(0, 8, "--batch=") == 0)
+        {
+            // seams taken from each cumulative energy map
+            options.batchSize = atoi(flag.c_str() + 8);
+            if (options.batchSize <= 0)
+            {
+                cerr << "error: batch size must be a positive number\n";
+                exit(1);
+            }
+        }
+        else if (flag.compare(0, 10, "--threads=") == 0)
+        {
+            // threads computing the energy and cumulative energy maps
+            options.threads = atoi(flag.c_str() + 10);
+            if (options.threads <= 0)
+            {
+                cerr << "error: thread count must be a positive number\n";
+                exit(1);
+            }
+        }
+        else
+        {
+            cerr << "error: unknown flag '" << flag << "'\n"
+                 << "supported flags: --full-energy, --threads=<n>, --batch=<k>, --optimal-order\n";
+            exit(1);
+        }
+    }
+
+    if (options.optimalOrder && options.batchSize > 1)
+    {
+        cerr << "error: --optimal-order carves one seam at a time and cannot be combined with --batch\n";
+        exit(1);
+    }
+
+    return options;
+}
+
 /// @brief  Write the seam-carved image map to a file. 
 /// @param imageMap The image map that has been modified by the seam carving algorithm.
 /// @param filename Name of the file to write the results to.
-void writeResults(const vector<vector<int>> &imageMap, const string &filename)
+/// @param binary Write a binary (P5) pgm file instead of a plain (P2) one.
+/// @note The file is formatted into a BufferedOutputFile, each row at once: plain pixels are turned into digits
+///       by hand, binary ones are copied (16-bit ones most significant byte first).
+template <typename Pixel>
+void writeResults(const Image<Pixel> &imageMap, const string &filename, bool binary)
 {
-    ofstream outFile(filename);
-
-    outFile << "P2\n"; // for pgm file type
-    outFile << "# Processed by Seam Carving Inc.\n"; // Seam Carving Incorporated!!!
-    outFile << imageMap[0].size() << " " << imageMap.size() << "\n";  // first the # columns, then # rows, to match pgm file format for irfanview
+    BufferedOutputFile outFile;
+    if (!outFile.open(filename))
+    {
+        cerr << "error: could not create file '" << filename << "'\n";
+        exit(1);
+    }
 
     // we need to iterate through the imageMap and find the maximum value
-    int max_val = imageMap[0][0];
-    for (const auto& row : imageMap) 
+    int max_val = imageMap(0, 0);
+    for (int i = 0; i < imageMap.rows; ++i) 
     {
-        for (auto val : row) 
-        {
-            if (val > max_val) 
-            {
-                max_val = val;
-            }
-        }
+        max_val = std::max(max_val, (int) *std::max_element(imageMap.row(i), imageMap.row(i) + imageMap.columns));
     }
-    outFile << max_val << "\n";
+    // a pgm file needs a positive maximum, even for an all black image
+    max_val = std::max(max_val, 1);
+
+    outFile.write(binary ? "P5\n" : "P2\n"); // for pgm file type
+    outFile.write("# Processed by Seam Carving Inc.\n"); // Seam Carving Incorporated!!!
+    outFile.write(std::to_string(imageMap.columns) + " " + std::to_string(imageMap.rows) + "\n"); // first the # columns, then # rows, to match pgm file format for irfanview
+    outFile.write(std::to_string(max_val) + "\n");
 
     // write processed image map
-    for (int i = 0; i < imageMap.size(); ++i)
+    for (int i = 0; i < imageMap.rows; ++i)
     {
-        for (int j = 0; j < imageMap[0].size(); ++j)
+        const Pixel *pixels = imageMap.row(i);
+        if (binary && max_val <= UINT8_MAX)
         {
-            outFile << imageMap[i][j] << " ";
+            char *out = outFile.reserve(imageMap.columns);
+            for (int j = 0; j < imageMap.columns; ++j)
+            {
+                out[j] = (char) pixels[j];
+            }
+            outFile.commit(imageMap.columns);
+        }
+        else if (binary)
+        {
+            char *out = outFile.reserve(2 * (size_t) imageMap.columns);
+            for (int j = 0; j < imageMap.columns; ++j)
+            {
+                out[2 * j] = (char) (pixels[j] >> 8);
+                out[2 * j + 1] = (char) pixels[j];
+            }
+            outFile.commit(2 * (size_t) imageMap.columns);
+        }
+        else
+        {
+            // at most 5 digits and a space per pixel, and the newline
+            char *out = outFile.reserve(6 * (size_t) imageMap.columns + 1);
+            char *next = out;
+            for (int j = 0; j < imageMap.columns; ++j)
+            {
+                char digits[5];
+                int count = 0;
+                unsigned value = pixels[j];
+                do
+                {
+                    digits[count++] = (char) ('0' + value % 10);
+                    value /= 10;
+                } while (value > 0);
+                while (count > 0)
+                {
+                    *next++ = digits[--count];
+                }
+                *next++ = ' ';
+            }
+            *next++ = '\n';
+            outFile.commit(next - out);
         }
-        outFile << "\n";
     }
 
-    return;
+    if (!outFile.close())
+    {
+        cerr << "error: could not write the results to '" << filename << "'\n";
+        exit(1);
+    }
 }
@@ -0,0 +1,175 @@
+/*
+    seamFileIO.hpp
+
+    file input and output for seam carving. the pgm file is mapped into memory and parsed where it lies, without
+    reading it into a string first. the result is formatted into a buffer that goes to the file with large write()
+    calls whenever it fills up.
+*/
+
+#ifndef SEAMFILEIO_HPP
+#define SEAMFILEIO_HPP
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/// @brief A read-only view of a whole file. Empty files are not mapped (mmap refuses them); data() is then NULL.
+class MappedFile
+{
+public:
+    MappedFile() : mapping(NULL), length(0) {}
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// @brief Map filename, returning false if it cannot be opened or mapped.
+    bool open(const std::string &filename)
+    {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+            return false;
+        }
+
+        struct stat filestatus;
+        if (fstat(fd, &filestatus) != 0 || !S_ISREG(filestatus.st_mode))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        length = filestatus.st_size;
+        if (length > 0)
+        {
+            void *address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED)
+            {
+                ::close(fd);
+                length = 0;
+                return false;
+            }
+            mapping = (const char *) address;
+
+            // the file is parsed front to back, let the kernel read ahead
+            madvise(address, length, MADV_SEQUENTIAL);
+        }
+
+        // the mapping stays valid after the descriptor is closed
+        ::close(fd);
+        return true;
+    }
+
+    void close()
+    {
+        if (mapping != NULL)
+        {
+            munmap((void *) mapping, length);
+        }
+        mapping = NULL;
+        length = 0;
+    }
+
+    const char *data() const { return mapping; }
+    size_t size() const { return length; }
+
+private:
+    const char *mapping;
+    size_t length;
+};
+
+/// @brief A file written front to back through a buffer of a fixed size, which is handed to write() whenever it fills.
+///        Anything still buffered is written by close(), or by the destructor if close() was not called.
+class BufferedOutputFile
+{
+public:
+    BufferedOutputFile() : fd(-1), used(0), failed(false), buffer(1 << 20) {}
+    ~BufferedOutputFile() { close(); }
+
+    BufferedOutputFile(const BufferedOutputFile &) = delete;
+    BufferedOutputFile &operator=(const BufferedOutputFile &) = delete;
+
+    /// @brief Create or truncate filename, returning false if it cannot be opened.
+    bool open(const std::string &filename)
+    {
+        close();
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        failed = fd < 0;
+        return !failed;
+    }
+
+    /// @brief Room for at least count more bytes at the end of the buffer, flushing it first if need be.
+    ///        The caller fills some of them and then passes the number filled to commit.
+    char *reserve(size_t count)
+    {
+        if (used + count > buffer.size())
+        {
+            flush();
+            if (count > buffer.size())
+            {
+                buffer.resize(count);
+            }
+        }
+        return &buffer[used];
+    }
+
+    void commit(size_t count) { used += count; }
+
+    void write(const char *data, size_t size)
+    {
+        memcpy(reserve(size), data, size);
+        commit(size);
+    }
+
+    void write(const std::string &text) { write(text.data(), text.size()); }
+
+    /// @brief Write out what is buffered and close the file, returning false if any write failed.
+    bool close()
+    {
+        if (fd < 0)
+        {
+            return !failed;
+        }
+        flush();
+        if (::close(fd) != 0)
+        {
+            failed = true;
+        }
+        fd = -1;
+        return !failed;
+    }
+
+private:
+    void flush()
+    {
+        const char *data = buffer.data();
+        size_t size = used;
+        used = 0;
+        while (size > 0 && !failed)
+        {
+            // write() may stop short (signals, pipes, huge requests), carry on from where it stopped
+            ssize_t written = ::write(fd, data, size);
+            if (written < 0)
+            {
+                failed = errno != EINTR;
+                continue;
+            }
+            data += written;
+            size -= written;
+        }
+    }
+
+    int fd;
+    size_t used;
+    bool failed;
+    std::vector<char> buffer;
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*
+    seamThreadPool.hpp
+
+    a fixed pool of worker threads for seam carving. the work of one stage (the energy map, one band of the
+    cumulative energy map, ...) is handed over as a number of tasks, which the workers and the calling thread
+    take in turn until none are left; run returns once all of them are done. the workers sleep between stages
+    and live as long as the pool, so a stage costs a wake-up instead of starting threads.
+*/
+
+#ifndef SEAMTHREADPOOL_HPP
+#define SEAMTHREADPOOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief Number of threads to use when none is requested: one per CPU.
+inline int defaultThreadCount()
+{
+    unsigned threads = std::thread::hardware_concurrency();
+    return threads > 0 ? (int) threads : 1;
+}
+
+class ThreadPool
+{
+public:
+    /// @brief Start threads - 1 workers; the thread calling run is the last one.
+    explicit ThreadPool(int threads) : taskCount(0), busy(0), generation(0), stopping(false), nextTask(0)
+    {
+        for (int t = 1; t < threads; ++t)
+        {
+            workers.push_back(std::thread(&ThreadPool::work, this));
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        taskPosted.notify_all();
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// @brief Number of threads sharing the tasks, the calling thread included.
+    int size() const { return (int) workers.size() + 1; }
+
+    /// @brief Run task(k) for every k in [0, count) and return once all of them are done.
+    template <typename Task>
+    void run(int count, const Task &task)
+    {
+        if (workers.empty() || count <= 1)
+        {
+            // nothing to share
+            for (int k = 0; k < count; ++k)
+            {
+                task(k);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            job = std::cref(task);
+            taskCount = count;
+            nextTask = 0;
+            busy = (int) workers.size();
+            ++generation;
+        }
+        taskPosted.notify_all();
+
+        runTasks();
+
+        std::unique_lock<std::mutex> guard(lock);
+        taskDone.wait(guard, [this]() { return busy == 0; });
+    }
+
+    /// @brief Split [begin, end) into a few ranges per thread and run task(rangeBegin, rangeEnd) on each.
+    template <typename Task>
+    void runRange(int begin, int end, const Task &task)
+    {
+        int ranges = std::max(1, std::min(end - begin, size() * 4));
+        run(ranges, [&](int k)
+        {
+            task(begin + (int) ((long long) (end - begin) * k / ranges), begin + (int) ((long long) (end - begin) * (k + 1) / ranges));
+        });
+    }
+
+private:
+    void work()
+    {
+        unsigned seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                taskPosted.wait(guard, [&]() { return stopping || generation != seen; });
+                if (stopping)
+                {
+                    return;
+                }
+                seen = generation;
+            }
+
+            runTasks();
+
+            std::lock_guard<std::mutex> guard(lock);
+            if (--busy == 0)
+            {
+                taskDone.notify_one();
+            }
+        }
+    }
+
+    // take tasks of the current job until there are none left
+    void runTasks()
+    {
+        for (int k = nextTask++; k < taskCount; k = nextTask++)
+        {
+            job(k);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex lock;
+    std::condition_variable taskPosted;
+    std::condition_variable taskDone;
+
+    // the current job, set under lock before generation moves on
+    std::function<void(int)> job;
+    int taskCount;
+    int busy;            // workers still running tasks of the current job
+    unsigned generation; // counts jobs, so a worker can tell a new one from the one it finished
+    bool stopping;
+    std::atomic<int> nextTask;
+};
+
+#endif